@@ -0,0 +1,143 @@
+/* Turns the extracted level and tile files into common/embedded.c, so
+ *  the game can be built with them inside (mingw32-make EMBED=1) and
+ *  read no files at run time. Run in the folder with level0-9.dat and
+ *  tile0-157.bmp. Tiles are stored as 8-bit indices into one palette
+ *  of the colors they use.
+ *  embed [file] writes to file instead of ./common/embedded.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/game.h"
+#include "../common/embedded.h"
+
+/* Bytes as part of a C initializer, 16 to a line. Signed bytes are
+   written as numbers, 0xFF would not fit an i8 in C++ */
+static void write_bytes(FILE *fout, const u8 *data, u32 size, const char *indent, int is_signed)
+{
+    u32 i;
+
+    for (i = 0; i < size; i++)
+    {
+        fputs(i % 16 ? "" : indent, fout);
+        if (is_signed)
+            fprintf(fout, "%d,", (i8)data[i]);
+        else
+            fprintf(fout, "0x%02X,", data[i]);
+        fputs(i % 16 == 15 || i + 1 == size ? "\n" : " ", fout);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out_file = argc > 1 ? argv[1] : "./common/embedded.c";
+    struct dave_level level[10];
+    struct embedded_tile tiles[ASSET_TILES];
+    u32 palette[256];
+    u32 colors = 0;
+    u8 *pixels = NULL;
+    u32 size = 0;
+    SDL_Surface *loaded;
+    SDL_Surface *surface;
+    FILE *fin;
+    FILE *fout;
+    char fname[16];
+    u32 color, c;
+    int i, x, y;
+
+    /* Levels go in as they are */
+    for (i = 0; i < 10; i++)
+    {
+        snprintf(fname, sizeof(fname), "level%d.dat", i);
+        fin = fopen(fname, "rb");
+        if (!fin || fread(&level[i], sizeof(struct dave_level), 1, fin) != 1)
+        {
+            fprintf(stderr, "Failed to read %s\n", fname);
+            return 1;
+        }
+        fclose(fin);
+    }
+
+    /* Tiles become palette indices */
+    for (i = 0; i < ASSET_TILES; i++)
+    {
+        snprintf(fname, sizeof(fname), "tile%d.bmp", i);
+        loaded = SDL_LoadBMP(fname);
+        surface = loaded ? SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0) : NULL;
+        SDL_FreeSurface(loaded);
+        if (!surface)
+        {
+            fprintf(stderr, "Failed to read %s\n", fname);
+            return 1;
+        }
+
+        tiles[i].w = (u16)surface->w;
+        tiles[i].h = (u16)surface->h;
+        tiles[i].offset = size;
+        pixels = (u8 *)realloc(pixels, size + surface->w * surface->h);
+
+        for (y = 0; y < surface->h; y++)
+        {
+            for (x = 0; x < surface->w; x++)
+            {
+                color = ((u32 *)((u8 *)surface->pixels + y * surface->pitch))[x] & 0xFFFFFF;
+                for (c = 0; c < colors && palette[c] != color; c++)
+                    ;
+                if (c == colors)
+                {
+                    if (colors == 256)
+                    {
+                        fprintf(stderr, "The tiles use more than 256 colors\n");
+                        return 1;
+                    }
+                    palette[colors++] = color;
+                }
+                pixels[size++] = (u8)c;
+            }
+        }
+        SDL_FreeSurface(surface);
+    }
+
+    fout = fopen(out_file, "w");
+    if (!fout)
+    {
+        fprintf(stderr, "Failed to open %s\n", out_file);
+        return 1;
+    }
+
+    fprintf(fout, "/* Generated by embed from level0-9.dat and tile0-157.bmp. Do not\n   edit, run embed again after changing them */\n\n#include \"embedded.h\"\n\n");
+
+    fprintf(fout, "const struct dave_level embedded_levels[10] =\n{\n");
+    for (i = 0; i < 10; i++)
+    {
+        fprintf(fout, "  {\n    {\n");
+        write_bytes(fout, (const u8 *)level[i].path, sizeof(level[i].path), "      ", 1);
+        fprintf(fout, "    },\n    {\n");
+        write_bytes(fout, level[i].tiles, sizeof(level[i].tiles), "      ", 0);
+        fprintf(fout, "    },\n    {\n");
+        write_bytes(fout, level[i].padding, sizeof(level[i].padding), "      ", 0);
+        fprintf(fout, "    }\n  },\n");
+    }
+    fprintf(fout, "};\n\n");
+
+    fprintf(fout, "const u8 embedded_palette[256][3] =\n{\n");
+    for (c = 0; c < colors; c++)
+        fprintf(fout, "  {0x%02X, 0x%02X, 0x%02X},\n", palette[c] >> 16 & 0xFF, palette[c] >> 8 & 0xFF, palette[c] & 0xFF);
+    fprintf(fout, "};\n\n");
+
+    fprintf(fout, "const struct embedded_tile embedded_tiles[ASSET_TILES] =\n{\n");
+    for (i = 0; i < ASSET_TILES; i++)
+        fprintf(fout, "  {%u, %u, %u},\n", tiles[i].w, tiles[i].h, tiles[i].offset);
+    fprintf(fout, "};\n\n");
+
+    fprintf(fout, "const u8 embedded_pixels[%u] =\n{\n", size);
+    write_bytes(fout, pixels, size, "  ", 0);
+    fprintf(fout, "};\n");
+
+    fclose(fout);
+    free(pixels);
+
+    printf("%s: 10 levels, %d tiles, %u colors, %u bytes of pixels\n", out_file, ASSET_TILES, colors, size);
+    return 0;
+}
@@ -0,0 +1,173 @@
+/* Runs the simulation without a window, as fast as the CPU allows.
+ *  Input comes from a seeded script instead of the keyboard, so the
+ *  same arguments always give the same result.
+ *  --record <file> saves the scripted game as a replay, --replay <file>
+ *  plays one back and checks it stays in sync. --repeat <n> runs the
+ *  scripted game n times and reports the fastest, for benchmarking.
+ *  --crowd <n> adds n monsters to the starting level, to see how the
+ *  entity stages scale (builds with a bigger ENTITY_MAX go past 32),
+ *  and counts the ones left at the end by their handles.
+ *  --loopback <ticks> plays a two-player netplay match over an
+ *  in-process link with that much delay (--loss <percent> drops some
+ *  packets) and checks rollback keeps both peers in sync.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/game.h"
+#include "../common/headless.h"
+
+/* Netplay match over a loopback link. Returns 1 if the peers went out
+   of sync */
+static int run_loopback(const struct game_state *start, u32 delay, u32 loss, u32 seed, u32 ticks)
+{
+    struct netplay *peers;
+    struct net_loopback *link;
+    u64 worst;
+    u32 wrong;
+    u32 p;
+
+    peers = (struct netplay *)malloc(2 * sizeof(struct netplay));
+    link = (struct net_loopback *)malloc(sizeof(struct net_loopback));
+    net_loopback_init(link, delay, loss, seed);
+
+    wrong = headless_loopback(peers, link, start, seed, ticks, &worst);
+
+    printf("%u ticks over loopback, %u ticks delay, %u%% loss\n", ticks, delay, loss);
+    for (p = 0; p < 2; p++)
+        printf("peer %u: %u rollbacks, %u ticks run again, %u stalls, %u desyncs\n", p, peers[p].rollbacks, peers[p].resimulated, peers[p].stalls, peers[p].desyncs);
+    printf("slowest tick with rollback: %.3f ms\n", worst * 1000.0 / SDL_GetPerformanceFrequency());
+    wrong += peers[0].desyncs + peers[1].desyncs;
+    printf("netplay: %s\n", wrong ? "out of sync" : "in sync");
+
+    free(peers);
+    free(link);
+    return wrong != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct game_state *game;
+    struct game_state *start;
+    struct input_script script;
+    struct replay replay;
+    const char *record_file = NULL;
+    const char *replay_file = NULL;
+    u32 ticks = 10000000; /* Ticks to simulate */
+    u32 seed = 1;         /* Input script seed */
+    int level = 0;        /* Starting level (0-9) */
+    u32 games = 0;
+    u32 repeat = 1;       /* Timed runs, the fastest is reported */
+    u32 crowd = 0;        /* Extra monsters on the starting level */
+    u32 *handles = NULL;  /* Theirs, to count the ones left */
+    u32 monsters;
+    int left = 0;
+    int delay = -1;       /* Loopback netplay link delay in ticks */
+    u32 loss = 0;         /* Loopback packets lost per 100 */
+    u64 timer_begin;
+    double seconds;
+    double elapsed;
+    u32 r;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--ticks") && i + 1 < argc)
+            ticks = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--level") && i + 1 < argc)
+            level = strtoul(argv[++i], NULL, 10) > 9 ? -1 : (int)strtoul(argv[i], NULL, 10);
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            record_file = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_file = argv[++i];
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--crowd") && i + 1 < argc)
+            crowd = (u32)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--loopback") && i + 1 < argc)
+            delay = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--loss") && i + 1 < argc)
+            loss = (u32)strtoul(argv[++i], NULL, 10);
+    }
+
+    if (level < 0)
+    {
+        printf("--level must be 0-9\n");
+        return 1;
+    }
+
+    /* Every restart copies this state. Levels after it load when the
+       game first reaches them */
+    game = (struct game_state *)malloc(sizeof(struct game_state));
+    start = (struct game_state *)malloc(sizeof(struct game_state));
+    init_game(start);
+    start->current_level = level;
+    start_level(start);
+    if (crowd && !replay_file && !record_file)
+    {
+        handles = (u32 *)malloc(crowd * sizeof(u32));
+        monsters = headless_crowd(start, crowd, seed, handles);
+        if (monsters < crowd)
+            printf("crowd: pool is full at %u entities\n", ENTITY_MAX);
+        crowd = monsters;
+    }
+    monsters = start->entities.live[ENTITY_MONSTER];
+    memcpy(game, start, sizeof(struct game_state));
+
+    input_script_init(&script, seed);
+
+    if (delay >= 0)
+        return run_loopback(start, (u32)delay, loss, seed, ticks);
+
+    if (replay_file && replay_load(&replay, replay_file))
+        return 1;
+
+    timer_begin = SDL_GetPerformanceCounter();
+    if (replay_file)
+        ticks = play_headless(game, &replay);
+    else if (record_file)
+        ticks = record_headless(game, &script, &replay, ticks);
+    seconds = (double)(SDL_GetPerformanceCounter() - timer_begin) / (double)SDL_GetPerformanceFrequency();
+
+    /* Every run starts over from the same state and seed */
+    for (r = 0; !replay_file && !record_file && r < (repeat ? repeat : 1); r++)
+    {
+        memcpy(game, start, sizeof(struct game_state));
+        input_script_init(&script, seed);
+
+        timer_begin = SDL_GetPerformanceCounter();
+        games = run_headless(game, start, &script, ticks);
+        elapsed = (double)(SDL_GetPerformanceCounter() - timer_begin) / (double)SDL_GetPerformanceFrequency();
+        if (!r || elapsed < seconds)
+            seconds = elapsed;
+    }
+
+    printf("%u ticks in %.3f s (%.0f ticks/s), %u games ended\n", ticks, seconds, ticks / seconds, games);
+    if (crowd && monsters)
+        printf("%u monsters, %.2f ns per monster per tick\n", monsters, seconds * 1e9 / ((double)ticks * monsters));
+    if (handles)
+    {
+        left = headless_crowd_left(game, handles, crowd);
+        if (left < 0)
+            printf("crowd: a monster's handle leads to another entity\n");
+        else
+            printf("crowd: %d of %u added monsters left\n", left, crowd);
+    }
+    printf("final: level %u score %u lives %u dave %d,%d\n", game->current_level + 1, game->score, game->lives, game->dave_px, game->dave_py);
+
+    if (replay_file)
+        printf("replay: %s\n", replay.mismatches || ticks != replay.ticks ? "out of sync" : "in sync");
+    else if (record_file)
+        replay_save(&replay, record_file);
+
+    free(game);
+    free(start);
+    free(handles);
+    if (replay_file || record_file)
+        replay_free(&replay);
+
+    return (replay_file && (replay.mismatches || ticks != replay.ticks)) || left < 0;
+}
@@ -1,4 +1,14 @@
+#include <stdlib.h>
+#include <string.h>
 #include "../common/game.h"
+#include "../common/profiler.h"
+#include "../common/trace.h"
+#include "../common/tileset.h"
+#include "../common/replay.h"
+#include "../common/savestate.h"
+#include "../common/netplay.h"
+#include "../common/assets.h"
+#include "../common/watch.h"
 
 /* Entry point */
 int main(int argc, char *argv[])
@@ -8,16 +18,160 @@ int main(int argc, char *argv[])
 
 	struct game_state *game;
 	struct game_assets *assets;
+	struct replay replay;
+	struct replay *demo = NULL;
+	struct autosave autosave;
+	struct net_transport transport;
+	struct netplay *net = NULL;
+	struct asset_watch watch;
+	int watching = 0;
+	const char *profile_file = NULL;
+	const char *trace_file = NULL;
+	const char *props_file = NULL;
+	const char *record_file = NULL;
+	const char *play_file = NULL;
+	const char *save_file = NULL;
+	const char *load_file = NULL;
+	const char *join_host = NULL;
+	char *colon;
+	int host_port = -1;
+	int i;
+
+	/* --profile <file> times the game loop and writes a JSON report at exit
+	   --trace <file> records a Chrome/Perfetto trace of every frame
+	   --tile-props <file> overrides tile behaviour for a custom tileset
+	   --record <file> saves every tick's input as a replay
+	   --play <file> plays a replay back instead of the keyboard
+	   --save <file> saves the session every time a level starts
+	   --load <file> resumes a saved session (not with replays)
+	   --latency-flash flashes a corner on the first frame showing a key press
+	   --host <port> waits on a UDP port for a two-player netplay match
+	   --join <host:port> joins one as the second player
+	   --frames <n> quits after n frames and prints how long each startup
+	                phase took (see startup.sh)
+	   --watch reloads level and tile files as they change (not with
+	           replays or netplay)
+	   --loose reads level and tile files in a build with them embedded */
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--profile") && i + 1 < argc)
+			profile_file = argv[++i];
+		else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+			trace_file = argv[++i];
+		else if (!strcmp(argv[i], "--tile-props") && i + 1 < argc)
+			props_file = argv[++i];
+		else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+			record_file = argv[++i];
+		else if (!strcmp(argv[i], "--play") && i + 1 < argc)
+			play_file = argv[++i];
+		else if (!strcmp(argv[i], "--save") && i + 1 < argc)
+			save_file = argv[++i];
+		else if (!strcmp(argv[i], "--load") && i + 1 < argc)
+			load_file = argv[++i];
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			profiler_frames = (u32)strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--watch"))
+			watching = assets_loose = 1;
+		else if (!strcmp(argv[i], "--loose"))
+			assets_loose = 1;
+		else if (!strcmp(argv[i], "--latency-flash"))
+			profiler_flash = 1;
+		else if (!strcmp(argv[i], "--host") && i + 1 < argc)
+			host_port = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--join") && i + 1 < argc)
+		{
+			join_host = argv[++i];
+			colon = strrchr(argv[i], ':');
+			if (!colon)
+			{
+				printf("--join needs host:port\n");
+				return 1;
+			}
+			*colon = '\0';
+			host_port = atoi(colon + 1);
+		}
+	}
+
+	/* Both peers start from a fresh game, replays and saves stay local */
+	if (host_port >= 0)
+	{
+		if (net_udp_open(&transport, join_host ? 0 : (u16)host_port, join_host, (u16)host_port))
+			return 1;
+		net = malloc(sizeof(struct netplay));
+		play_file = NULL;
+		record_file = NULL;
+		save_file = NULL;
+		load_file = NULL;
+	}
+
+	if (play_file && replay_load(&replay, play_file))
+		return 1;
+
+	startup_mark(STARTUP_BEGIN);
+	profiler_init();
+	profiler_enabled = profile_file ? PROFILE_TIMERS : 0;
+	if (trace_file)
+		trace_start(trace_file);
 
 	/* Allocate and initialize game state and assets */
 	game = malloc(sizeof(struct game_state));
 	assets = malloc(sizeof(struct game_assets));
 
-	init_game(game);
-	init_sdl(&window, &renderer);					 /* Initialize SDL */
-	init_assets(assets, renderer);				 /* Initialize assets */
+	PROFILE(PROF_INIT_GAME, init_game(game));                 /* Initialize game state */
+	startup_mark(STARTUP_INIT_GAME);
+	if (props_file)
+		load_tile_props(props_file);
+	PROFILE(PROF_INIT_ASSETS, init_assets(assets, game->current_level)); /* Decode assets in the background */
+	startup_mark(STARTUP_INIT_ASSETS);
+	init_sdl(&window, &renderer);                             /* Initialize SDL */
+	startup_mark(STARTUP_INIT_SDL);
 	start_level(game);
-	run_game_loop(game, renderer, assets); /* Game loop with fixed time step at 30 FPS*/
+	startup_mark(STARTUP_START_LEVEL);
+	if (play_file)
+		demo = replay_start(&replay, game) ? NULL : &replay;
+	else if (record_file)
+	{
+		replay_record(&replay, game);
+		demo = &replay;
+	}
+	else if (load_file)
+		savestate_load(game, load_file);
+	if (save_file)
+		autosave_init(&autosave, game, save_file);
+	if (net)
+		netplay_init(net, game, join_host != NULL, &transport);
+	if (watching && !demo && !net)
+	{
+		watch_open(&watch);
+		assets->watch = &watch;
+	}
+	run_game_loop(game, renderer, assets, demo, save_file ? &autosave : NULL, net); /* Game loop with fixed time step at 30 FPS*/
+
+	trace_stop();
+	if (assets->watch)
+		watch_close(&watch);
+	if (profiler_frames)
+		startup_print();
+	if (profile_file)
+		profiler_dump(profile_file);
+	if (demo && demo->mode == REPLAY_RECORD)
+		replay_save(demo, record_file);
+	if (demo && demo->mismatches)
+		printf("Replay went out of sync %u times\n", demo->mismatches);
+	if (play_file || record_file)
+		replay_free(&replay);
+	if (net)
+	{
+		if (net->ended == NETPLAY_REMOTE_QUIT)
+			printf("Netplay: the other player left\n");
+		else if (net->ended == NETPLAY_TIMED_OUT)
+			printf("Netplay: lost the other player, nothing heard for %u s\n", NETPLAY_TIMEOUT / 30);
+		else
+			netplay_quit(net);
+		printf("Netplay: %u rollbacks, %u ticks run again, %u stalls, %u desyncs\n", net->rollbacks, net->resimulated, net->stalls, net->desyncs);
+		net_close(&transport);
+		free(net);
+	}
 
 	/* Clean up and quit */
 	SDL_Quit();
@@ -0,0 +1,130 @@
+/* Searches for a route through each level, trophy then door, with a
+ *  parallel beam search over the simulation, and saves each one as a
+ *  replay (route1.rep ... route10.rep). Exits with 1 if a level has no
+ *  route within the tick limit, or a route found does not finish its
+ *  level when played back, or its replay cannot be saved. Level 10 is
+ *  the one exception, see ROUTE_UNSOLVED.
+ *  --level <n> searches one level (0-9), --width <n> sets the states
+ *  kept per layer (a level without a route is retried at up to 16
+ *  times that), --ticks <n> the longest route, --threads <n> the
+ *  workers, --out <prefix> the replay file names.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/game.h"
+#include "../common/route.h"
+#include "../common/replay.h"
+
+#define ROUTE_WIDEN 16      /* Widest retry, times --width */
+
+/* Level 10 has no route yet: the search finds Dave falling through the
+   floor of the start room and walking along the row above the level, a
+   simulation bug, and never the trophy. Its missing route is reported but
+   does not fail the run */
+#define ROUTE_UNSOLVED 9
+
+/* Play a route back from a fresh game into a replay. Returns 1 if it
+   does not finish the level */
+static int record_route(const struct route_result *route, u8 level, const char *fname)
+{
+    struct game_state *game;
+    struct replay replay;
+    u32 t;
+    int failed;
+
+    game = (struct game_state *)malloc(sizeof(struct game_state));
+    init_game(game);
+    game->current_level = level;
+    start_level(game);
+
+    replay_record(&replay, game);
+    for (t = 0; t < route->ticks; t++)
+        replay_step(&replay, game, route->inputs[t]);
+
+    failed = game->current_level == level && !game->quit;
+    if (!failed)
+        failed = replay_save(&replay, fname);
+
+    replay_free(&replay);
+    free(game);
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    struct game_state *start;
+    struct route_result route;
+    u32 width = 256;        /* States kept per layer */
+    u32 ticks = 6000;       /* Longest route per level */
+    int threads = SDL_GetCPUCount();
+    int first = 0;          /* Levels to search (0-9) */
+    int last = 9;
+    const char *prefix = "route";
+    char fname[256];
+    u64 total = 0;
+    double seconds = 0;
+    int failed = 0;
+    int level;
+    u32 w;
+    int j;
+
+    for (j = 1; j < argc; j++)
+    {
+        if (!strcmp(argv[j], "--level") && j + 1 < argc)
+            first = last = strtoul(argv[++j], NULL, 10) > 9 ? -1 : (int)strtoul(argv[j], NULL, 10);
+        else if (!strcmp(argv[j], "--width") && j + 1 < argc)
+            width = (u32)strtoul(argv[++j], NULL, 10);
+        else if (!strcmp(argv[j], "--ticks") && j + 1 < argc)
+            ticks = (u32)strtoul(argv[++j], NULL, 10);
+        else if (!strcmp(argv[j], "--threads") && j + 1 < argc)
+            threads = atoi(argv[++j]);
+        else if (!strcmp(argv[j], "--out") && j + 1 < argc)
+            prefix = argv[++j];
+    }
+
+    if (first < 0)
+    {
+        printf("--level must be 0-9\n");
+        return 1;
+    }
+
+    start = (struct game_state *)malloc(sizeof(struct game_state));
+
+    for (level = first; level <= last; level++)
+    {
+        /* start_level loads the level, or finds it loaded already */
+        init_game(start);
+        start->current_level = level;
+        start_level(start);
+
+        /* A level the beam misses gets searched again, twice as wide */
+        for (w = width; ; w *= 2)
+        {
+            route_search(start, w, ticks, threads, &route);
+            total += route.simulated;
+            seconds += route.seconds;
+            if (route.found || w >= width * ROUTE_WIDEN)
+                break;
+            route_free(&route);
+        }
+
+        printf("level %d: ", level + 1);
+        if (route.found)
+            printf("%u ticks (%.2f s of play)", route.ticks, route.ticks / 30.0);
+        else
+            printf("no route within %u ticks%s", ticks, level == ROUTE_UNSOLVED ? " (known bug)" : "");
+        printf(", width %u, %u layers, %llu states, %llu duplicates, %.3f s\n", w, route.layers, (unsigned long long)route.nodes, (unsigned long long)route.duplicates, route.seconds);
+
+        snprintf(fname, sizeof(fname), "%s%d.rep", prefix, level + 1);
+        if (route.found ? record_route(&route, (u8)level, fname) : level != ROUTE_UNSOLVED)
+            failed = 1;
+        route_free(&route);
+    }
+
+    printf("%llu ticks simulated on %d threads in %.3f s (%.0f ticks/s)\n", (unsigned long long)total, threads, seconds, total / seconds);
+
+    free(start);
+    return failed;
+}
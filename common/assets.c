@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <string.h>
+#include "assets.h"
+#include "levelcache.h"
+#include "profiler.h"
+#include "tileset.h"
+#include "trace.h"
+#ifdef EMBED_ASSETS
+#include "embedded.h"
+#endif
+
+u8 assets_loose;
+
+/* Mark a tile and its animation frames */
+static void need(u8 *needed, u8 tile)
+{
+  u8 j;
+
+  for (j = 0; j < tile_props[tile].frames && tile + j < ASSET_TILES; j++)
+    needed[tile + j] = 1;
+}
+
+/* Order the tiles after the fixed ones, the starting level's first.
+   Waits for the level */
+static void plan(struct asset_loader *loader)
+{
+  u8 placed[ASSET_TILES];
+  u8 needed[ASSET_TILES];
+  u16 count = loader->fixed;
+  int level = loader->level;
+  int i;
+
+  memset(placed, 0, sizeof(placed));
+  memset(needed, 0, sizeof(needed));
+  for (i = 0; i < loader->fixed; i++)
+    placed[loader->order[i]] = 1;
+
+  level_require(level);
+  for (i = 0; i < 1000; i++)
+  {
+    if (levels[level].tiles[i] < ASSET_TILES)
+      need(needed, levels[level].tiles[i]);
+  }
+
+  /* Levels 3 on have one kind of monster, 89 + 4 per level past 2,
+     and their bullets */
+  if (level >= 2)
+  {
+    for (i = 0; i < 4; i++)
+      needed[81 + 4 * level + i] = 1;
+    needed[121] = 1;
+    needed[124] = 1;
+  }
+
+  for (i = 0; i < ASSET_TILES; i++)
+  {
+    if (needed[i] && !placed[i])
+      loader->order[count++] = (u8)i;
+  }
+  loader->first = count;
+  for (i = 0; i < ASSET_TILES; i++)
+  {
+    if (!needed[i] && !placed[i])
+      loader->order[count++] = (u8)i;
+  }
+
+  /* order must be visible before planned is */
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&loader->planned, 1);
+}
+
+/* Decode tiles in order until none are left. The first thread in
+   orders the level's tiles while the others start on the fixed ones */
+static void decode_tiles(struct asset_loader *loader)
+{
+  int n;
+  u8 i;
+
+  if (SDL_AtomicCAS(&loader->planning, 0, 1))
+    plan(loader);
+
+  while ((n = SDL_AtomicAdd(&loader->next, 1)) < ASSET_TILES)
+  {
+    while (n >= loader->fixed && !SDL_AtomicGet(&loader->planned))
+      SDL_Delay(1);
+    SDL_MemoryBarrierAcquire();
+
+    i = loader->order[n];
+    PROFILE(PROF_LOAD_TILE, loader->surface[i] = load_tile(i));
+    SDL_AtomicSet(&loader->decoded[i], 1);
+  }
+}
+
+/* Decode thread, traced as such */
+static int decode(void *data)
+{
+  trace_thread_begin("decode");
+  decode_tiles((struct asset_loader *)data);
+  return 0;
+}
+
+/* Start decoding the tileset, Dave's and that level's tiles first.
+   Does not wait for the level */
+void init_assets(struct game_assets *assets, int level)
+{
+  struct asset_loader *loader;
+  u16 count = 0;
+  int i, k;
+
+  assets->startup = SDL_GetPerformanceCounter();
+  assets->watch = NULL;
+  memset(assets->graphics_tiles, 0, sizeof(assets->graphics_tiles));
+
+  loader = (struct asset_loader *)calloc(1, sizeof(struct asset_loader));
+  assets->loader = loader;
+  loader->level = level;
+
+  /* Every level draws Dave, in any of his frames, his bullets and the
+     status bar. The level's tiles follow, once it is read */
+  for (i = 0; i < ASSET_TILES; i++)
+  {
+    if ((i >= 53 && i <= 59) || (i >= 67 && i <= 68) || (i >= 71 && i <= 73) || (i >= 77 && i <= 82) || i >= 127)
+      loader->order[count++] = (u8)i;
+  }
+  loader->fixed = count;
+
+  loader->threads = SDL_GetCPUCount();
+  if (loader->threads < 1)
+    loader->threads = 1;
+  if (loader->threads > ASSET_MAX_THREADS)
+    loader->threads = ASSET_MAX_THREADS;
+
+  for (k = 0; k < loader->threads; k++)
+  {
+    loader->thread[k] = SDL_CreateThread(decode, "decode", loader);
+    if (!loader->thread[k])
+      break;
+  }
+  loader->threads = k;
+
+  /* No threads, decode it all here */
+  if (!k)
+    decode_tiles(loader);
+}
+
+/* Make textures of the tiles decoded so far. Render thread only.
+   Returns 1 once the first frame can be drawn */
+int upload_assets(struct game_assets *assets, SDL_Renderer *renderer)
+{
+  struct asset_loader *loader = assets->loader;
+  int i, k;
+
+  if (!loader)
+    return 1;
+
+  for (i = 0; i < ASSET_TILES; i++)
+  {
+    if (loader->uploaded[i] || !SDL_AtomicGet(&loader->decoded[i]))
+      continue;
+
+    assets->graphics_tiles[i] = SDL_CreateTextureFromSurface(renderer, loader->surface[i]);
+    SDL_FreeSurface(loader->surface[i]);
+    loader->uploaded[i] = 1;
+    loader->resident++;
+  }
+
+  if (loader->resident == ASSET_TILES)
+  {
+    for (k = 0; k < loader->threads; k++)
+      SDL_WaitThread(loader->thread[k], NULL);
+    free(loader);
+    assets->loader = NULL;
+    return 1;
+  }
+
+  if (!SDL_AtomicGet(&loader->planned))
+    return 0;
+  SDL_MemoryBarrierAcquire();
+
+  for (i = 0; i < loader->first; i++)
+  {
+    if (!loader->uploaded[loader->order[i]])
+      return 0;
+  }
+
+  return 1;
+}
+
+/* Wait for the decode threads and upload whatever is left */
+void finish_assets(struct game_assets *assets, SDL_Renderer *renderer)
+{
+  int k;
+
+  if (!assets->loader)
+    return;
+
+  for (k = 0; k < assets->loader->threads; k++)
+    SDL_WaitThread(assets->loader->thread[k], NULL);
+  assets->loader->threads = 0;
+
+  upload_assets(assets, renderer);
+}
+
+/* Tile whose lit pixels are see-through in tile i, for Dave's
+   sprites. -1 for the rest */
+int tile_mask(int i)
+{
+  if (i >= 53 && i <= 59)
+    return i + 7;
+  if (i >= 67 && i <= 68)
+    return i + 2;
+  if (i >= 71 && i <= 73)
+    return i + 3;
+  if (i >= 77 && i <= 82)
+    return i + 6;
+  return -1;
+}
+
+#ifdef EMBED_ASSETS
+/* Surface of a tile built into the executable */
+static SDL_Surface *embedded_tile(int i)
+{
+  const struct embedded_tile *tile = &embedded_tiles[i];
+  const u8 *index = &embedded_pixels[tile->offset];
+  const u8 *rgb;
+  SDL_Surface *surface;
+  u32 *row;
+  int x, y;
+
+  surface = SDL_CreateRGBSurfaceWithFormat(0, tile->w, tile->h, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (!surface)
+    return NULL;
+
+  for (y = 0; y < tile->h; y++)
+  {
+    row = (u32 *)((u8 *)surface->pixels + y * surface->pitch);
+    for (x = 0; x < tile->w; x++)
+    {
+      rgb = embedded_palette[*index++];
+      row[x] = SDL_MapRGB(surface->format, rgb[0], rgb[1], rgb[2]);
+    }
+  }
+
+  return surface;
+}
+#endif
+
+/* Tile i as it is stored, built in or tile<i>.bmp */
+static SDL_Surface *read_tile(int i)
+{
+  char fname[13];
+
+#ifdef EMBED_ASSETS
+  if (!assets_loose)
+    return embedded_tile(i);
+#endif
+
+  snprintf(fname, sizeof(fname), "tile%d.bmp", i);
+  return SDL_LoadBMP(fname);
+}
+
+/* Load a tile and apply its mask or transparency. NULL if a file is
+   missing */
+SDL_Surface *load_tile(int i)
+{
+  int j;
+  SDL_Surface *surface;
+  SDL_Surface *mask;
+  uint8_t *surf_p;
+  uint8_t *mask_p;
+
+  surface = read_tile(i);
+  if (!surface)
+    return NULL;
+
+  if (tile_mask(i) >= 0)
+  {
+    mask = read_tile(tile_mask(i));
+    if (!mask)
+    {
+      SDL_FreeSurface(surface);
+      return NULL;
+    }
+
+    surf_p = (uint8_t *)surface->pixels;
+    mask_p = (uint8_t *)mask->pixels;
+
+    /* Write mask white background to dave tile */
+    for (j = 0; j < (mask->pitch * mask->h); j++)
+      surf_p[j] = mask_p[j] ? 0xFF : surf_p[j];
+
+    /* Make white mask transparent */
+    SDL_SetColorKey(surface, 1, SDL_MapRGB(surface->format, 0xFF, 0xFF, 0xFF));
+    SDL_FreeSurface(mask);
+  }
+  /* Monster tiles should use black transparency */
+  else if ((i >= 89 && i <= 120) || (i >= 129 && i <= 132))
+    SDL_SetColorKey(surface, 1, SDL_MapRGB(surface->format, 0x00, 0x00, 0x00));
+
+  return surface;
+}
+
+/* Replace one tile's texture after its file changed, and the tiles it
+   masks. Render thread only. Returns 0 on success */
+int reload_tile(struct game_assets *assets, SDL_Renderer *renderer, int i)
+{
+  SDL_Surface *surface;
+  SDL_Texture *texture;
+  int j;
+
+  for (j = 0; j < ASSET_TILES; j++)
+  {
+    if (j != i && tile_mask(j) == i && reload_tile(assets, renderer, j))
+      return 1;
+  }
+
+  surface = load_tile(i);
+  if (!surface)
+    return 1;
+  texture = SDL_CreateTextureFromSurface(renderer, surface);
+  SDL_FreeSurface(surface);
+  if (!texture)
+    return 1;
+
+  if (assets->graphics_tiles[i])
+    SDL_DestroyTexture(assets->graphics_tiles[i]);
+  assets->graphics_tiles[i] = texture;
+  return 0;
+}
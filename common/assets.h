@@ -0,0 +1,47 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include "game.h"
+
+#define ASSET_TILES 158
+#define ASSET_MAX_THREADS 8
+
+/* Tileset decode in the background
+ * -init_assets starts worker threads decoding tile<n>.bmp, masks
+ *  applied, into surfaces. It needs no renderer, so it runs while
+ *  init_sdl creates the window
+ * -the tiles Dave and the status bar use decode first, then the
+ *  starting level's and its monsters'. The first decode thread waits for the level to
+ *  order those, the caller never does
+ * -upload_assets, on the render thread, turns finished surfaces into
+ *  textures. It returns 1 once the first frame's tiles are all in,
+ *  the rest keep arriving between frames
+ */
+struct asset_loader
+{
+  SDL_Surface *surface[ASSET_TILES];
+  SDL_atomic_t decoded[ASSET_TILES];  /* surface is ready to upload */
+  SDL_atomic_t next;                  /* Next place in order to decode */
+  u8 order[ASSET_TILES];              /* Tile indices, decode order */
+  u8 uploaded[ASSET_TILES];
+  int level;                          /* Starting level */
+  u16 fixed;                          /* Leading tiles of order every level needs */
+  u16 first;                          /* Leading tiles of order the first frame needs */
+  SDL_atomic_t planning;              /* A thread has taken on ordering the rest */
+  SDL_atomic_t planned;               /* order and first are complete */
+  u16 resident;                       /* Tiles uploaded so far */
+  int threads;
+  SDL_Thread *thread[ASSET_MAX_THREADS];
+};
+
+/* Read tiles and levels from files even in a build with them embedded */
+extern u8 assets_loose;
+
+void init_assets(struct game_assets *, int);
+int upload_assets(struct game_assets *, SDL_Renderer *);
+void finish_assets(struct game_assets *, SDL_Renderer *);
+int tile_mask(int);
+SDL_Surface *load_tile(int);
+int reload_tile(struct game_assets *, SDL_Renderer *, int);
+
+#endif // ASSETS_H
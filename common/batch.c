@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "headless.h"
+#include "lockstep.h"
+#include "workpool.h"
+
+struct batch_worker
+{
+  int id;
+  struct batch_pool *pool;
+  struct game_state game; /* Private copy, no state is shared between workers */
+  struct lockstep *lanes; /* Private lanes in lockstep mode */
+};
+
+struct batch_pool
+{
+  const struct game_state *start;
+  u32 seed;
+  u32 ticks;
+  u8 lockstep;
+  struct batch_results *results;
+  struct workpool work;   /* Instances left to run */
+};
+
+void batch_results_init(struct batch_results *results, u32 count)
+{
+  results->count = count;
+  results->seed = (u32 *)calloc(count, sizeof(u32));
+  results->ticks = (u32 *)calloc(count, sizeof(u32));
+  results->score = (u32 *)calloc(count, sizeof(u32));
+  results->deaths = (u16 *)calloc(count, sizeof(u16));
+  results->level = (u8 *)calloc(count, sizeof(u8));
+}
+
+void batch_results_free(struct batch_results *results)
+{
+  free(results->seed);
+  free(results->ticks);
+  free(results->score);
+  free(results->deaths);
+  free(results->level);
+  memset(results, 0, sizeof(struct batch_results));
+}
+
+/* Play instance i from the start state until it ends or runs out of ticks.
+   Each instance only writes its own row of the results */
+static void run_instance(struct batch_pool *pool, struct game_state *game, u32 i)
+{
+  struct input_script script;
+  u32 seed = pool->seed + i;
+  u32 t;
+  u16 deaths = 0;
+  u8 level;
+  u8 dying = 0;
+
+  memcpy(game, pool->start, sizeof(struct game_state));
+  input_script_init(&script, seed);
+  level = game->current_level;
+
+  for (t = 0; t < pool->ticks && !game->quit; t++)
+  {
+    step_game(game, input_script_next(&script));
+
+    if (game->dave_dead_timer && !dying)
+      deaths++;
+    dying = game->dave_dead_timer != 0;
+
+    if (game->current_level > level)
+      level = game->current_level;
+  }
+
+  pool->results->seed[i] = seed;
+  pool->results->ticks[i] = t;
+  pool->results->score[i] = game->score;
+  pool->results->deaths[i] = deaths;
+  pool->results->level[i] = level + 1;
+}
+
+/* Lockstep worker. Each lane plays one instance at a time; a lane whose
+   game ends records its outcome and starts the next instance, so lanes
+   only sit idle once the whole batch is drained */
+static void run_lanes(struct batch_worker *worker)
+{
+  struct batch_pool *pool = worker->pool;
+  struct lockstep *lanes = worker->lanes;
+  struct input_script script[LOCKSTEP_LANES];
+  u32 instance[LOCKSTEP_LANES];
+  u32 ticks[LOCKSTEP_LANES];
+  u16 deaths[LOCKSTEP_LANES];
+  u8 level[LOCKSTEP_LANES];
+  u8 dying[LOCKSTEP_LANES];
+  u8 busy[LOCKSTEP_LANES];
+  u8 input[LOCKSTEP_LANES];
+  u32 running = 0;
+  u8 drained = 0;
+  u32 k, i;
+
+  lockstep_init(lanes, pool->start, LOCKSTEP_LANES);
+  memset(busy, 0, sizeof(busy));
+
+  do
+  {
+    /* Start new instances in free lanes */
+    for (k = 0; k < LOCKSTEP_LANES; k++)
+    {
+      if (busy[k] || drained)
+        continue;
+
+      if (!workpool_take(&pool->work, worker->id, &i))
+      {
+        drained = 1;
+        continue;
+      }
+
+      lockstep_load(lanes, k, pool->start);
+      input_script_init(&script[k], pool->seed + i);
+      instance[k] = i;
+      ticks[k] = 0;
+      deaths[k] = 0;
+      level[k] = pool->start->current_level;
+      dying[k] = 0;
+      busy[k] = 1;
+      running++;
+    }
+
+    /* Free lanes step on with no input, their state is never read */
+    for (k = 0; k < LOCKSTEP_LANES; k++)
+      input[k] = busy[k] ? input_script_next(&script[k]) : 0;
+
+    lockstep_step(lanes, input);
+
+    for (k = 0; k < LOCKSTEP_LANES; k++)
+    {
+      if (!busy[k])
+        continue;
+
+      ticks[k]++;
+      if (lanes->dave_dead_timer[k] && !dying[k])
+        deaths[k]++;
+      dying[k] = lanes->dave_dead_timer[k] != 0;
+
+      if (lanes->current_level[k] > level[k])
+        level[k] = lanes->current_level[k];
+
+      if (lanes->quit[k] || ticks[k] == pool->ticks)
+      {
+        i = instance[k];
+        pool->results->seed[i] = pool->seed + i;
+        pool->results->ticks[i] = ticks[k];
+        pool->results->score[i] = lanes->score[k];
+        pool->results->deaths[i] = deaths[k];
+        pool->results->level[i] = level[k] + 1;
+        busy[k] = 0;
+        running--;
+      }
+    }
+  } while (running);
+}
+
+static int run_worker(void *data)
+{
+  struct batch_worker *worker = (struct batch_worker *)data;
+  u32 i;
+
+  if (worker->pool->lockstep && worker->pool->ticks)
+  {
+    run_lanes(worker);
+    return 0;
+  }
+
+  while (workpool_take(&worker->pool->work, worker->id, &i))
+    run_instance(worker->pool, &worker->game, i);
+
+  return 0;
+}
+
+/* Run count instances of start on a pool of threads, instance i with
+   input script seed + i, for at most ticks each. With lockstep, each
+   worker steps LOCKSTEP_LANES instances together. Results are the same
+   for any number of threads, with or without lockstep */
+void run_batch(const struct game_state *start, u32 seed, u32 count, u32 ticks, int threads, u8 lockstep, struct batch_results *results)
+{
+  struct batch_pool pool;
+  struct batch_worker *worker;
+  int k;
+
+  pool.start = start;
+  pool.seed = seed;
+  pool.ticks = ticks;
+  pool.lockstep = lockstep;
+  pool.results = results;
+
+  /* Deal out equal ranges up front, stealing evens out long games */
+  workpool_init(&pool.work, count, threads);
+  worker = (struct batch_worker *)calloc(pool.work.threads, sizeof(struct batch_worker));
+  for (k = 0; k < pool.work.threads; k++)
+  {
+    worker[k].id = k;
+    worker[k].pool = &pool;
+    if (lockstep)
+      worker[k].lanes = (struct lockstep *)malloc(sizeof(struct lockstep));
+  }
+
+  workpool_run(&pool.work, run_worker, worker, sizeof(struct batch_worker), "batch");
+
+  for (k = 0; k < pool.work.threads; k++)
+    free(worker[k].lanes);
+  free(worker);
+}
+
+static void write_column(FILE *fout, const char *name, const u32 *u32_column, const u16 *u16_column, const u8 *u8_column, u32 count, int last)
+{
+  u32 i;
+
+  fprintf(fout, "\"%s\":[", name);
+  for (i = 0; i < count; i++)
+  {
+    if (u32_column)
+      fprintf(fout, "%s%u", i ? "," : "", u32_column[i]);
+    else if (u16_column)
+      fprintf(fout, "%s%u", i ? "," : "", u16_column[i]);
+    else
+      fprintf(fout, "%s%u", i ? "," : "", u8_column[i]);
+  }
+  fprintf(fout, "]%s\n", last ? "" : ",");
+}
+
+/* Write results as JSON with one array per column. Returns 0 on success */
+int batch_results_save(const struct batch_results *results, const char *fname)
+{
+  FILE *fout = fopen(fname, "w");
+
+  if (!fout)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  fprintf(fout, "{\"count\":%u,\n", results->count);
+  write_column(fout, "seed", results->seed, NULL, NULL, results->count, 0);
+  write_column(fout, "ticks", results->ticks, NULL, NULL, results->count, 0);
+  write_column(fout, "score", results->score, NULL, NULL, results->count, 0);
+  write_column(fout, "deaths", NULL, results->deaths, NULL, results->count, 0);
+  write_column(fout, "level", NULL, NULL, results->level, results->count, 1);
+  fprintf(fout, "}\n");
+
+  fclose(fout);
+  return 0;
+}
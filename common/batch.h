@@ -0,0 +1,23 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "game.h"
+
+/* Outcome of every instance, one array per column */
+struct batch_results
+{
+  u32 count;
+  u32 *seed;   /* Input script seed */
+  u32 *ticks;  /* Ticks until the game ended, or the tick limit */
+  u32 *score;
+  u16 *deaths;
+  u8 *level;   /* Highest level reached (1-10) */
+};
+
+void batch_results_init(struct batch_results *, u32);
+void batch_results_free(struct batch_results *);
+int batch_results_save(const struct batch_results *, const char *);
+
+void run_batch(const struct game_state *, u32, u32, u32, int, u8, struct batch_results *);
+
+#endif // BATCH_H
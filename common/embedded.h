@@ -0,0 +1,27 @@
+#ifndef EMBEDDED_H
+#define EMBEDDED_H
+
+#include "game.h"
+#include "assets.h"
+
+/* Level and tile data compiled into the executable, from the
+   common/embedded.c that embed (c/embed.c) generates
+ * -levels are the level files byte for byte
+ * -a tile is w x h 8-bit indices into palette, row by row, starting at
+ *  offset in pixels. The palette holds the colors the tiles use
+ * Only built with -DEMBED_ASSETS (mingw32-make EMBED=1), then levels
+ * and tiles are read from these unless assets_loose is set.
+ */
+struct embedded_tile
+{
+  u16 w;
+  u16 h;
+  u32 offset;
+};
+
+extern const struct dave_level embedded_levels[10];
+extern const u8 embedded_palette[256][3];
+extern const struct embedded_tile embedded_tiles[ASSET_TILES];
+extern const u8 embedded_pixels[];
+
+#endif // EMBEDDED_H
@@ -0,0 +1,149 @@
+#include <string.h>
+#include "entity.h"
+
+/* Generations run 1 to 0xFFFF, so no live handle is ENTITY_NONE */
+static u16 next_generation(u16 generation)
+{
+  return generation == 0xFFFF ? 1 : generation + 1;
+}
+
+/* Zero dense entries from to count - 1 */
+static void clear_dense(struct entity_pool *pool, u16 from)
+{
+  u16 n = pool->count - from;
+
+  memset(&pool->kind[from], 0, n);
+  memset(&pool->type[from], 0, n);
+  memset(&pool->dead_timer[from], 0, n);
+  memset(&pool->dir[from], 0, n);
+  memset(&pool->x[from], 0, n);
+  memset(&pool->y[from], 0, n);
+  memset(&pool->px[from], 0, n * sizeof(u16));
+  memset(&pool->py[from], 0, n * sizeof(u16));
+  memset(&pool->path_step[from], 0, n * sizeof(u16));
+  memset(&pool->slot[from], 0, n * sizeof(u16));
+}
+
+/* Destroy everything. Handles given out before stay invalid */
+void entity_clear(struct entity_pool *pool)
+{
+  u16 i;
+
+  for (i = 0; i < pool->count; i++)
+  {
+    if (pool->kind[i] != ENTITY_FREE)
+      pool->generation[pool->slot[i]] = next_generation(pool->generation[pool->slot[i]]);
+  }
+
+  clear_dense(pool, 0);
+  memset(pool->index, 0, sizeof(pool->index));
+  memset(pool->live, 0, sizeof(pool->live));
+  pool->count = 0;
+  pool->used = 0;
+  pool->free_slot = 0;
+}
+
+/* Add an entity of a kind at the end of the dense arrays, all fields
+   zero. Returns its dense index, or -1 if the pool is full */
+int entity_spawn(struct entity_pool *pool, u8 kind)
+{
+  u16 slot;
+  u16 i;
+
+  if (pool->count == ENTITY_MAX)
+    return -1;
+
+  /* Destroyed entities free their slot right away, so one is free */
+  if (pool->free_slot)
+  {
+    slot = pool->free_slot - 1;
+    pool->free_slot = pool->index[slot];
+  }
+  else
+    slot = pool->used++;
+
+  if (!pool->generation[slot])
+    pool->generation[slot] = 1;
+
+  i = pool->count++;
+  pool->kind[i] = kind;
+  pool->slot[i] = slot;
+  pool->index[slot] = i;
+  pool->live[kind]++;
+
+  return i;
+}
+
+/* Free an entity's handle. Its dense entry turns ENTITY_FREE and stays
+   put until entity_compact, so loops over the pool can destroy as they go */
+void entity_destroy(struct entity_pool *pool, u16 i)
+{
+  u16 slot = pool->slot[i];
+
+  if (pool->kind[i] == ENTITY_FREE)
+    return;
+
+  pool->live[pool->kind[i]]--;
+  pool->kind[i] = ENTITY_FREE;
+  pool->generation[slot] = next_generation(pool->generation[slot]);
+  pool->index[slot] = pool->free_slot;
+  pool->free_slot = slot + 1;
+}
+
+/* Close the gaps destroyed entities left, keeping spawn order. Once per
+   tick, so every entity costs the same however many come and go */
+void entity_compact(struct entity_pool *pool)
+{
+  u16 i, j;
+
+  if (pool->live[ENTITY_MONSTER] + pool->live[ENTITY_DBULLET] + pool->live[ENTITY_EBULLET] == pool->count)
+    return;
+
+  for (i = 0, j = 0; i < pool->count; i++)
+  {
+    if (pool->kind[i] == ENTITY_FREE)
+      continue;
+
+    if (i != j)
+    {
+      pool->kind[j] = pool->kind[i];
+      pool->type[j] = pool->type[i];
+      pool->dead_timer[j] = pool->dead_timer[i];
+      pool->dir[j] = pool->dir[i];
+      pool->x[j] = pool->x[i];
+      pool->y[j] = pool->y[i];
+      pool->px[j] = pool->px[i];
+      pool->py[j] = pool->py[i];
+      pool->path_step[j] = pool->path_step[i];
+      pool->slot[j] = pool->slot[i];
+      pool->index[pool->slot[j]] = j;
+    }
+    j++;
+  }
+
+  /* Keep the unused tail zero, states compare and compress as bytes */
+  clear_dense(pool, j);
+  pool->count = j;
+}
+
+/* Handle of the entity at dense index i */
+u32 entity_handle(const struct entity_pool *pool, u16 i)
+{
+  return (u32)pool->generation[pool->slot[i]] << 16 | pool->slot[i];
+}
+
+/* Dense index of a handle's entity, or -1 once it has been destroyed */
+int entity_index(const struct entity_pool *pool, u32 handle)
+{
+  u16 slot = handle & 0xFFFF;
+  u16 i;
+
+  if (slot >= pool->used || pool->generation[slot] != handle >> 16)
+    return -1;
+
+  i = pool->index[slot];
+  if (i >= pool->count || pool->slot[i] != slot || pool->kind[i] == ENTITY_FREE)
+    return -1;
+
+  return i;
+}
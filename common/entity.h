@@ -0,0 +1,13 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include "game.h"
+
+void entity_clear(struct entity_pool *);
+int entity_spawn(struct entity_pool *, u8);
+void entity_destroy(struct entity_pool *, u16);
+void entity_compact(struct entity_pool *);
+u32 entity_handle(const struct entity_pool *, u16);
+int entity_index(const struct entity_pool *, u32);
+
+#endif // ENTITY_H
@@ -1,6 +1,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include "game.h"
+#include "snapshot.h"
+#include "profiler.h"
+#include "trace.h"
+#include "tileset.h"
+#include "replay.h"
+#include "savestate.h"
+#include "rewind.h"
+#include "entity.h"
+#include "spatial.h"
+#include "input.h"
+#include "netplay.h"
+#include "statehash.h"
+#include "levelcache.h"
+#include "assets.h"
+#include "watch.h"
+#ifdef EMBED_ASSETS
+#include "embedded.h"
+#endif
 
 #ifdef __cplusplus
 #include <fstream>
@@ -8,10 +26,13 @@
 using namespace std;
 #endif
 
+struct dave_level levels[10];
+struct monster_track tracks[10];
+
 void init_sdl(SDL_Window **window, SDL_Renderer **renderer)
 {
   // Initialize SDL
-  if (SDL_Init(SDL_INIT_VIDEO))
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER))
     SDL_Log("SDL error: %s", SDL_GetError());
 
   // Create a window and renderer
@@ -26,34 +47,227 @@ void init_sdl(SDL_Window **window, SDL_Renderer **renderer)
   SDL_RenderClear(*renderer);
 }
 
-void run_game_loop(struct game_state *game, SDL_Renderer *renderer, struct game_assets *assets)
+/* State shared by the render (main) thread and the simulation thread */
+struct game_loop
+{
+  struct game_state *game;
+  struct replay *replay;
+  struct autosave *autosave;
+  struct rewind_buffer *rewind;
+  struct netplay *net;
+  struct asset_watch *watch;
+  struct triple_buffer snapshots;
+  struct input_queue input;
+  SDL_atomic_t quit;
+};
+
+/* Simulation thread. Fixed time step at 30 FPS, publishes a render state every tick */
+static int run_simulation(void *data)
 {
   const u32 FRAME_DELAY = 33; // Frame delay in milliseconds
+  struct game_loop *loop = (struct game_loop *)data;
+  struct game_state *game = loop->game;
   u32 timer_begin;
   u32 timer_end;
   u32 delay;
+  u64 tick_begin;
+  struct input_tick tick;
+  struct render_state *state;
+  u64 input_time = 0;
+  u64 sim_time = 0;
+  u8 input_press = 0;
+  u8 pending = 0;
+  u8 input;
+
+  trace_thread_begin("simulation");
 
-  /* Game loop with fixed time step at 30 FPS*/
   while (!game->quit)
   {
     timer_begin = SDL_GetTicks();
+    tick_begin = PROFILE_NOW();
+
+    if (SDL_AtomicGet(&loop->quit))
+    {
+      /* A netplay game belongs to both peers, leave it be */
+      if (loop->net)
+        break;
+      game->quit = 1;
+    }
 
-    check_input(game);
-    update_game(game);
-    render(game, renderer, assets);
+    /* Levels edited since the last tick */
+    if (loop->watch)
+      watch_levels(loop->watch, game);
+
+    /* Take everything since the last tick, taps included */
+    input_take(&loop->input, &tick);
+    input = tick.held | tick.pressed;
+    if (tick.first && tick_begin)
+      profiler_record(PROF_INPUT_DELAY, tick.first);
+    if (loop->net)
+    {
+      /* Held back while waiting on the remote, so taps still count */
+      pending |= input & ~INPUT_REWIND;
+      if (netplay_advance(loop->net, pending))
+        pending = 0;
+      else if (loop->net->ended)
+        break;
+    }
+    else if (loop->replay)
+      replay_step(loop->replay, game, input & ~INPUT_REWIND);
+    else if (input & INPUT_REWIND)
+      rewind_pop(loop->rewind, game);
+    else
+    {
+      step_game(game, input);
+      rewind_push(loop->rewind, game);
+    }
+    if (loop->autosave)
+      autosave_step(loop->autosave, game);
+
+    /* Tag the states that follow with this tick's input, until the
+       render thread presents one of them */
+    if (tick.first)
+    {
+      input_time = tick.first;
+      sim_time = SDL_GetPerformanceCounter();
+      input_press = tick.pressed != 0;
+    }
+
+    state = snapshot_back(&loop->snapshots);
+    snapshot_capture(game, state);
+    state->input_time = input_time;
+    state->sim_time = sim_time;
+    state->input_press = input_press;
+    snapshot_publish(&loop->snapshots);
+
+    if (tick_begin)
+      profiler_record(PROF_TICK, tick_begin);
 
     timer_end = SDL_GetTicks();
     delay = FRAME_DELAY - (timer_end - timer_begin);
     delay = delay > FRAME_DELAY ? 0 : delay;
     SDL_Delay(delay);
   }
+
+  SDL_AtomicSet(&loop->quit, 1);
+  return 0;
+}
+
+/* Runs the simulation on its own thread while this thread polls input and
+   draws the newest published state. A stalled SDL_RenderPresent can no
+   longer hold up a game tick. With a replay the ticks are recorded to it,
+   or played back from it instead of the keyboard. With netplay the local
+   player's game is the one shown, and both advance through it. Otherwise,
+   holding backspace rewinds up to 30 seconds. With a watch on the
+   assets, edited tiles and levels are reloaded as the game runs. The
+   first tick waits for the first frame's tiles */
+void run_game_loop(struct game_state *game, SDL_Renderer *renderer, struct game_assets *assets, struct replay *replay, struct autosave *autosave, struct netplay *net)
+{
+  struct game_loop loop;
+  struct render_state *state;
+  SDL_Thread *simulation;
+  u8 quit = 0;
+  u64 frame_begin;
+  u64 shown = 0;
+  u32 presented = 0;
+  u8 fresh;
+
+  loop.game = net ? &net->game[net->local] : game;
+  loop.replay = replay;
+  loop.autosave = autosave;
+  loop.net = net;
+  loop.watch = assets->watch;
+  loop.rewind = NULL;
+  if (!replay && !net)
+  {
+    loop.rewind = (struct rewind_buffer *)malloc(sizeof(struct rewind_buffer));
+    rewind_init(loop.rewind, game);
+  }
+  snapshot_init(&loop.snapshots);
+  input_init(&loop.input);
+  SDL_AtomicSet(&loop.quit, 0);
+
+  /* Tiles still decoding become textures as they come in. The game
+     does not start until the ones the first frame needs are there */
+  while (!upload_assets(assets, renderer))
+  {
+    input_poll(&loop.input, &quit);
+    if (quit)
+    {
+      finish_assets(assets, renderer);
+      input_close(&loop.input);
+      free(loop.rewind);
+      return;
+    }
+    SDL_Delay(1);
+  }
+
+  simulation = SDL_CreateThread(run_simulation, "simulation", &loop);
+  if (!simulation)
+  {
+    SDL_Log("Thread error: %s", SDL_GetError());
+    finish_assets(assets, renderer);
+    input_close(&loop.input);
+    free(loop.rewind);
+    return;
+  }
+
+  while (!SDL_AtomicGet(&loop.quit))
+  {
+    frame_begin = PROFILE_NOW();
+
+    /* Queue input until the simulation thread picks it up */
+    PROFILE(PROF_CHECK_INPUT, input_poll(&loop.input, &quit));
+
+    if (quit)
+      SDL_AtomicSet(&loop.quit, 1);
+
+    /* The rest of the tiles become textures between frames */
+    upload_assets(assets, renderer);
+    if (assets->watch)
+      watch_poll(assets->watch, assets, renderer);
+
+    /* Only redraw when the simulation has moved on */
+    state = snapshot_acquire(&loop.snapshots);
+    if (state)
+    {
+      /* First frame to show the newest input */
+      fresh = state->input_time && state->input_time != shown;
+      state->flash = fresh && state->input_press && profiler_flash;
+
+      PROFILE(PROF_RENDER, render(state, renderer, assets));
+      if (frame_begin)
+        profiler_record(PROF_FRAME, frame_begin);
+      if (!presented && profiler_enabled)
+        profiler_record(PROF_FIRST_FRAME, assets->startup);
+      startup_mark(STARTUP_FIRST_FRAME);
+      presented++;
+      if (profiler_frames && presented >= profiler_frames)
+        SDL_AtomicSet(&loop.quit, 1);
+
+      if (fresh && frame_begin)
+      {
+        profiler_record(PROF_PRESENT_DELAY, state->sim_time);
+        profiler_record(PROF_INPUT_LATENCY, state->input_time);
+      }
+      if (fresh)
+        shown = state->input_time;
+    }
+    else
+      SDL_Delay(1);
+  }
+
+  SDL_WaitThread(simulation, NULL);
+  finish_assets(assets, renderer);
+  input_close(&loop.input);
+  free(loop.rewind);
 }
 
 /* Set game and monster properties to default values */
 void init_game(struct game_state *game)
 {
-  int j;
-  char fname[13];
+  /* Start from all zeroes so runs with the same input are identical */
+  memset(game, 0, sizeof(struct game_state));
 
   // Initialize game state variables
   game->quit = 0;
@@ -69,185 +283,214 @@ void init_game(struct game_state *game)
   game->dave_py = game->dave_y * TILE_SIZE;
   game->jump_timer = 0;
   game->on_ground = 1;
-  game->try_right = 0;
-  game->try_left = 0;
-  game->try_jump = 0;
-  game->dave_right = 0;
-  game->dave_left = 0;
-  game->dave_jump = 0;
-  game->dave_up = 0;
-  game->dave_down = 0;
-  game->dave_jetpack = 0;
-
-  /* Deactivate all monsters */
-  for (j = 0; j < 5; j++)
-    game->monster[j].type = 0;
+  game->try_input = 0;
+  game->dave_action = 0;
+
+  /* No monsters or bullets */
+  entity_clear(&game->entities);
+
+  /* Tile behaviour is shared by every game, build it once */
+  if (!tile_props[0].frames)
+    init_tile_props();
   
-  /* Load each level from level<xxx>.dat. (see LEVEL.c utility) */
-  for (int j = 0; j < 10; j++)
+  /* Levels load from level<xxx>.dat as they are started (see LEVEL.c
+     utility). The first one reads while SDL and the assets come up */
+  level_prefetch(game->current_level);
+}
+
+/* Read one level file into a level record. Returns 0 on success */
+int load_level(struct dave_level *level, int index)
+{
+  char fname[13];
+
+#ifdef EMBED_ASSETS
+  if (!assets_loose)
   {
-    /* Make new file name */
-    snprintf(fname, sizeof(fname), "level%d.dat", j);
+    *level = embedded_levels[index];
+    return 0;
+  }
+#endif
+
+  /* Make new file name */
+  snprintf(fname, sizeof(fname), "level%d.dat", index);
 
 #ifdef __cplusplus
-    // C++ File Handling
-    ifstream file_level(fname, ios::binary);
-    if (!file_level)
-    {
-      cerr << "Failed to open " << fname << endl;
-      continue;
-    }
+  // C++ File Handling
+  ifstream file_level(fname, ios::binary);
+  if (!file_level)
+  {
+    cerr << "Failed to open " << fname << endl;
+    return 1;
+  }
 
-    // Read data into game struct
-    file_level.read(reinterpret_cast<char *>(game->level[j].path), sizeof(game->level[j].path));
-    file_level.read(reinterpret_cast<char *>(game->level[j].tiles), sizeof(game->level[j].tiles));
-    file_level.read(reinterpret_cast<char *>(game->level[j].padding), sizeof(game->level[j].padding));
+  // Read data into level struct
+  file_level.read(reinterpret_cast<char *>(level->path), sizeof(level->path));
+  file_level.read(reinterpret_cast<char *>(level->tiles), sizeof(level->tiles));
+  file_level.read(reinterpret_cast<char *>(level->padding), sizeof(level->padding));
 
 #else
-    // C File Handling
-    FILE *file_level = fopen(fname, "rb");
-    if (!file_level)
-    {
-      fprintf(stderr, "Failed to open %s\n", fname);
-      continue;
-    }
+  // C File Handling
+  FILE *file_level = fopen(fname, "rb");
+  if (!file_level)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
 
-    // Stream bytes into game struct
-    fread(game->level[j].path, sizeof(game->level[j].path), 1, file_level);
-    fread(game->level[j].tiles, sizeof(game->level[j].tiles), 1, file_level);
-    fread(game->level[j].padding, sizeof(game->level[j].padding), 1, file_level);
+  // Stream bytes into level struct
+  fread(level->path, sizeof(level->path), 1, file_level);
+  fread(level->tiles, sizeof(level->tiles), 1, file_level);
+  fread(level->padding, sizeof(level->padding), 1, file_level);
 
-    fclose(file_level);
+  fclose(file_level);
 #endif
-  }
+
+  return 0;
 }
 
-/* Bring in tileset from tile<xxx>.bmp files from original binary (see TILES.C)*/
-void init_assets(struct game_assets *assets, SDL_Renderer *renderer)
+/* Walk a level's monster path once, step by step as the original game
+   does, recording where a monster is after each step. Stops when the
+   walk gets back to a state it has already been in, which makes the
+   rest of the track a loop.
+   Path data - https://moddingwiki.shikadi.net/wiki/Dangerous_Dave_Level_format */
+void compile_track(struct monster_track *track, const struct dave_level *level)
 {
-  int i, j;
-  char fname[13];
-  char file_num[4];
-  char mname[13];
-  char mask_num[4];
-  SDL_Surface *surface;
-  SDL_Surface *mask;
-  uint8_t *surf_p;
-  uint8_t *mask_p;
-  uint8_t mask_offset;
-
-  for (i = 0; i < 158; i++)
+  u16 seen[512];
+  u16 step = 0;
+  u16 key;
+  u8 path_index = 0;
+  i8 next_px = 0;
+  i8 next_py = 0;
+  i16 x = 0;
+  i16 y = 0;
+
+  memset(seen, 0xFF, sizeof(seen));
+  track->x[0] = 0;
+  track->y[0] = 0;
+  track->loop_start = 0;
+
+  for (;;)
   {
-    fname[0] = '\0';
-    strcat(fname, "tile");
-    sprintf(&file_num[0], "%u", i);
-    strcat(fname, file_num);
-    strcat(fname, ".bmp");
+    /* Every path repeats through a waypoint fetch or a 0xEA restart,
+       those two states are all that need remembering */
+    key = 0xFFFF;
+    if (!next_px && !next_py)
+      key = path_index;
+    else if (next_px == (signed char)0xEA && next_py == (signed char)0xEA)
+      key = 256 + path_index;
+
+    if (key != 0xFFFF && seen[key] != 0xFFFF)
+    {
+      track->loop_start = seen[key];
+      break;
+    }
+    if (key != 0xFFFF)
+      seen[key] = step;
 
-    if ((i >= 53 && i <= 59) || i == 67 || i == 68 || (i >= 71 && i <= 73) || (i >= 77 && i <= 82))
+    /* Only garbage paths get this long, loop the whole track */
+    if (step == TRACK_MAX)
+      break;
+
+    /* Get the next path waypoint, x and y is stored in pair */
+    if (!next_px && !next_py)
     {
-      if (i >= 53 && i <= 59)
-        mask_offset = 7;
-      if (i >= 67 && i <= 68)
-        mask_offset = 2;
-      if (i >= 71 && i <= 73)
-        mask_offset = 3;
-      if (i >= 77 && i <= 82)
-        mask_offset = 6;
-
-      mname[0] = '\0';
-      strcat(mname, "tile");
-      sprintf(&mask_num[0], "%u", i + mask_offset);
-      strcat(mname, mask_num);
-      strcat(mname, ".bmp");
-
-      surface = SDL_LoadBMP(fname);
-      mask = SDL_LoadBMP(mname);
-
-      surf_p = (uint8_t *)surface->pixels;
-      mask_p = (uint8_t *)mask->pixels;
-
-      /* Write mask white background to dave tile */
-      for (j = 0; j < (mask->pitch * mask->h); j++)
-        surf_p[j] = mask_p[j] ? 0xFF : surf_p[j];
-
-      /* Make white mask transparent */
-      SDL_SetColorKey(surface, 1, SDL_MapRGB(surface->format, 0xFF, 0xFF, 0xFF));
-      assets->graphics_tiles[i] = SDL_CreateTextureFromSurface(renderer, surface);
-      SDL_FreeSurface(surface);
-      SDL_FreeSurface(mask);
+      next_px = level->path[path_index];
+      next_py = level->path[path_index + 1];
+      path_index += 2;
     }
-    else
+
+    /* End of path = 0xEA -- back to the start of path */
+    if (next_px == (signed char)0xEA && next_py == (signed char)0xEA)
     {
-      surface = SDL_LoadBMP(fname);
+      next_px = level->path[0];
+      next_py = level->path[1];
+      path_index = 2;
+    }
 
-      /* Monster tiles should use black transparency */
-      if ((i >= 89 && i <= 120) || (i >= 129 && i <= 132))
-        SDL_SetColorKey(surface, 1, SDL_MapRGB(surface->format, 0x00, 0x00, 0x00));
-      assets->graphics_tiles[i] = SDL_CreateTextureFromSurface(renderer, surface);
+    /* One pixel towards the waypoint on each axis */
+    if (next_px < 0)
+    {
+      x--;
+      next_px++;
     }
-  };
+    if (next_px > 0)
+    {
+      x++;
+      next_px--;
+    }
+    if (next_py < 0)
+    {
+      y--;
+      next_py++;
+    }
+    if (next_py > 0)
+    {
+      y++;
+      next_py--;
+    }
+
+    step++;
+    track->x[step] = x;
+    track->y[step] = y;
+  }
+
+  track->loop_end = step;
 }
 
-/* Checks input and sets flags. First step of the game loop */
-void check_input(struct game_state *game)
+/* Sets flags from latched input. First step of the game loop */
+void apply_input(struct game_state *game, u8 input)
 {
-  SDL_Event event;
-  SDL_PollEvent(&event);
-
-  const u8 *keystate = SDL_GetKeyboardState(NULL);
-  if (keystate[SDL_SCANCODE_RIGHT])
-    game->try_right = 1;
-  if (keystate[SDL_SCANCODE_LEFT])
-    game->try_left = 1;
-  if (keystate[SDL_SCANCODE_UP])
-    game->try_jump = 1;
-  if (keystate[SDL_SCANCODE_DOWN])
-    game->try_down = 1;
-  if (keystate[SDL_SCANCODE_LCTRL])
-    game->try_fire = 1;
-  if (keystate[SDL_SCANCODE_LALT])
-    game->try_jetpack = 1;
-
-  if (event.type == SDL_QUIT)
-    game->quit = 1;
+  game->try_input |= input & INPUT_KEYS;
+}
+
+/* One simulation tick driven by INPUT_* flags. Needs no window, so it
+   can run headless and faster than real time */
+void step_game(struct game_state *game, u8 input)
+{
+  apply_input(game, input);
+  PROFILE(PROF_UPDATE_GAME, update_game(game));
 }
 
 /* Updates world, entities, and handles input flags .
    Second step of the game loop */
 void update_game(struct game_state *game)
 {
-  check_collision(game);
-  pickup_item(game, game->check_pickup_x, game->check_pickup_y);
-  update_dbullet(game);
-  update_ebullet(game);
-  verify_input(game);
-  move_dave(game);
-  move_monsters(game);
-  fire_monsters(game);
-  scroll_screen(game);
-  apply_gravity(game);
-  update_level(game);
-  clear_input(game);
+  PROFILE(PROF_CHECK_COLLISION, check_collision(game));
+  PROFILE(PROF_PICKUP_ITEM, pickup_item(game, game->check_pickup_x, game->check_pickup_y));
+  PROFILE(PROF_UPDATE_DBULLET, update_dbullet(game));
+  PROFILE(PROF_UPDATE_EBULLET, update_ebullet(game));
+  PROFILE(PROF_VERIFY_INPUT, verify_input(game));
+  PROFILE(PROF_MOVE_DAVE, move_dave(game));
+  PROFILE(PROF_MOVE_MONSTERS, move_monsters(game));
+  PROFILE(PROF_FIRE_MONSTERS, fire_monsters(game));
+  PROFILE(PROF_SCROLL_SCREEN, scroll_screen(game));
+  PROFILE(PROF_APPLY_GRAVITY, apply_gravity(game));
+  PROFILE(PROF_UPDATE_LEVEL, update_level(game));
+  PROFILE(PROF_CLEAR_INPUT, clear_input(game));
 }
 
-/* Renders the world. First step of the game loop */
-void render(struct game_state *game, SDL_Renderer *renderer, struct game_assets *assets)
+/* Renders the newest published state. Runs on the render thread */
+void render(struct render_state *game, SDL_Renderer *renderer, struct game_assets *assets)
 {
   /* Clear back buffer with black */
   SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
   SDL_RenderClear(renderer);
 
   /* Draw world elements */
-  draw_world(game, assets, renderer);
-  draw_dave(game, assets, renderer);
-  draw_monsters(game, assets, renderer);
-  draw_dave_bullet(game, assets, renderer);
-  draw_monster_bullet(game, assets, renderer);
-  draw_ui(game, assets, renderer);
+  PROFILE(PROF_DRAW_WORLD, draw_world(game, assets, renderer));
+  PROFILE(PROF_DRAW_DAVE, draw_dave(game, assets, renderer));
+  PROFILE(PROF_DRAW_MONSTERS, draw_monsters(game, assets, renderer));
+  PROFILE(PROF_DRAW_DAVE_BULLET, draw_dave_bullet(game, assets, renderer));
+  PROFILE(PROF_DRAW_MONSTER_BULLET, draw_monster_bullet(game, assets, renderer));
+  PROFILE(PROF_DRAW_UI, draw_ui(game, assets, renderer));
+
+  if (profiler_overlay)
+    draw_profiler(renderer);
+  if (game->flash)
+    draw_latency_flash(renderer);
 
   /* Swaps display buffers (puts above drawing on the screen)*/
-  SDL_RenderPresent(renderer);
+  PROFILE(PROF_RENDER_PRESENT, SDL_RenderPresent(renderer));
 }
 
 /* Updates dave's collision point state */
@@ -267,75 +510,62 @@ void check_collision(struct game_state *game)
   game->collision_point[7] = is_clear(game, game->dave_px + 3, game->dave_py + 4, 1);
 
   /* Is dave on the ground? */
-  game->on_ground = ((!game->collision_point[4] && !game->collision_point[5]) || game->dave_climb);
+  game->on_ground = ((!game->collision_point[4] && !game->collision_point[5]) || (game->dave_action & DAVE_CLIMB));
 
   grid_x = (game->dave_px + 6) / TILE_SIZE;
   grid_y = (game->dave_py + 8) / TILE_SIZE;
 
   /* Don't check outside the room */
 	if (grid_x < 100 && grid_y < 10)
-		type = game->level[game->current_level].tiles[grid_y * 100 + grid_x];
+		type = level_tile(game, grid_y * 100 + grid_x);
 	else
 		type = 0;
 
   /* Can dave climb something in his current location (Trees? Stars?) */
-	if ((type >= 33 && type <= 35) || type == 41)
+	if (tile_props[type].flags & TILE_CLIMB)
 		game->can_climb = 1;
 	else
 	{
 		game->can_climb = 0;
-		game->dave_climb = 0;
+		game->dave_action &= ~DAVE_CLIMB;
 	}
 }
 
 /* Clear flags set by keyboard input */
 void clear_input(struct game_state *game)
 {
-  game->try_jump = 0;
-  game->try_right = 0;
-  game->try_left = 0;
-  game->try_fire = 0;
-  game->try_jetpack = 0;
-  game->try_down = 0;
-  game->try_up = 0;
+  game->try_input = 0;
 }
 
 void pickup_item(struct game_state *game, u8 grid_x, u8 grid_y)
 {
 	u8 type;
+	u16 index;
+	struct tile_property *props;
 
 	/* No pickups outside of the world (or you'll lbe eaten by the grue) */
 	if (!grid_x || !grid_y)
 		return;
 
 	/* Get the type */
-	type = game->level[game->current_level].tiles[grid_y * 100 + grid_x];
+	index = grid_y * 100 + grid_x;
+	type = level_tile(game, index);
+	props = &tile_props[type];
 
 	/* Handle the type */
-	switch (type)
-	{
-	  /* Jetpack pickup */
-		case 4: game->jetpack = 0xFF; break;
-		/* Trophy pickup */
-		case 10:
-		{
-      add_score(game,1000);
-			game->trophy = 1;
-		} break;
-		/* Gun pickup */
-		case 20: game->gun = 1; break;
-    /* Collectibls pickup */
-		case 47: add_score(game,100); break;
-		case 48: add_score(game,50); break;
-		case 49: add_score(game,150); break;
-		case 50: add_score(game,300); break;
-		case 51: add_score(game,200); break;
-		case 52: add_score(game,500); break;
-		default: break;
-	}
+	if (props->flags & TILE_JETPACK)
+		game->jetpack = 0xFF;
+	if (props->flags & TILE_TROPHY)
+		game->trophy = 1;
+	if (props->flags & TILE_GUN)
+		game->gun = 1;
+	if (props->score)
+		add_score(game, props->score);
 
 	/* Clear the pickup tile */
-	game->level[game->current_level].tiles[grid_y * 100 + grid_x] = 0;
+	if (!(game->pickups[index / 8] & (1 << index % 8)))
+		game->pickup_hash ^= pickup_key(index);
+	game->pickups[index / 8] |= 1 << index % 8;
 
 	/* Clear the pickup handler */
 	game->check_pickup_x = 0;
@@ -345,46 +575,49 @@ void pickup_item(struct game_state *game, u8 grid_x, u8 grid_y)
 /* Move Dave's bullets */
 void update_dbullet(struct game_state *game)
 {
-  u8 i, grid_x, grid_y, mx, my;
+  struct entity_pool *e = &game->entities;
+  struct spatial_grid grid;
+  u16 hits[ENTITY_MAX];
+  u32 count, j;
+  u16 i;
+  u8 grid_x, grid_y;
+  u8 monsters = e->live[ENTITY_MONSTER] != 0;
 
-  /* No bullet in world - Not active */
-  if (!game->dbullet_px || !game->dbullet_py)
+  if (!e->live[ENTITY_DBULLET])
     return;
 
-  game->dbullet_px += game->dbullet_dir * 4;
+  /* With no monsters left the bullets still fly, there is just nothing
+     to hit */
+  if (monsters)
+    spatial_build(&grid, e, ENTITY_MONSTER);
 
-  /* Bullet hit something - deactivate */
-  if (!is_clear(game, game->dbullet_px, game->dbullet_py, 0))
-    game->dbullet_px = game->dbullet_py = 0;
+  for (i = 0; i < e->count; i++)
+  {
+    /* Bullets parked at 0 are inert, as the single bullet was */
+    if (e->kind[i] != ENTITY_DBULLET || !e->px[i] || !e->py[i])
+      continue;
 
-  grid_x = game->dbullet_px / TILE_SIZE;
-  grid_y = game->dbullet_py / TILE_SIZE;
+    e->px[i] += e->dir[i] * 4;
+    grid_x = e->px[i] / TILE_SIZE;
+    grid_y = e->py[i] / TILE_SIZE;
 
-  /* Bullet left room - deactivate */
-  if (grid_x - game->view_x < 1 || grid_x - game->view_x > 20)
-    game->dbullet_px = game->dbullet_py = 0;
+    /* Bullet hit something or left room - deactivate */
+    if (!is_clear(game, e->px[i], e->py[i], 0) || grid_x - game->view_x < 1 || grid_x - game->view_x > 20)
+    {
+      entity_destroy(e, i);
+      continue;
+    }
 
-    /* Bullet active */
-  if (game->dbullet_px)
-  {
-    game->dbullet_px += game->dbullet_dir * 4;
+    e->px[i] += e->dir[i] * 4;
 
-    /* Check all monster positions */
-    for (i = 0; i < 5; i++)
+    /* A monster covers its tile and the ones right and below */
+    count = monsters ? spatial_query(&grid, grid_x - 1, grid_y - 1, grid_x, grid_y, hits) : 0;
+    for (j = 0; j < count; j++)
     {
-      if (game->monster[i].type)
-      {
-        mx = game->monster[i].monster_x;
-        my = game->monster[i].monster_y;
-
-        if ((grid_y == my || grid_y == my + 1) && (grid_x == mx || grid_x == mx + 1))
-        {
-          /* Dave's bullet hits monster - destroy bullet and monster */
-          game->dbullet_px = game->dbullet_py = 0;
-          game->monster[i].dead_timer = 30;
-          add_score(game, 300);
-        }
-      }
+      /* Dave's bullet hits monster - destroy bullet and monster */
+      entity_destroy(e, i);
+      e->dead_timer[hits[j]] = 30;
+      add_score(game, 300);
     }
   }
 }
@@ -392,53 +625,73 @@ void update_dbullet(struct game_state *game)
 /* Move Monster's bullets */
 void update_ebullet(struct game_state *game)
 {
-  /* No bullet in world - Not active */
-  if (!game->ebullet_px || !game->ebullet_py)
-    return;
+  struct entity_pool *e = &game->entities;
+  u8 grid_x, grid_y;
+  u16 i;
 
-  /* Bullet hit something - deactivate */
-  if (!is_clear(game, game->ebullet_px, game->ebullet_py, 0))
-    game->ebullet_px = game->ebullet_py = 0;
+  for (i = 0; i < e->count; i++)
+  {
+    /* Bullets parked at 0 are inert, as the single bullet was */
+    if (e->kind[i] != ENTITY_EBULLET || !e->px[i] || !e->py[i])
+      continue;
 
-  /* Bullet left room - deactivate */
-  if (!is_visible(game, game->ebullet_px))
-    game->ebullet_px = game->ebullet_py = 0;
+    /* Bullet hit something or left room - deactivate */
+    if (!is_clear(game, e->px[i], e->py[i], 0) || !is_visible(game, e->px[i]))
+    {
+      entity_destroy(e, i);
+      continue;
+    }
 
-  if (game->ebullet_px)
-  {
-    u8 grid_x, grid_y;
-    game->ebullet_px += game->ebullet_dir * 4;
+    e->px[i] += e->dir[i] * 4;
 
-    grid_x = game->ebullet_px / TILE_SIZE;
-    grid_y = game->ebullet_py / TILE_SIZE;
+    grid_x = e->px[i] / TILE_SIZE;
+    grid_y = e->py[i] / TILE_SIZE;
 
     /* Compare with Dave's position */
     if (grid_y == game->dave_y && grid_x == game->dave_x)
     {
       /* Monster's bullet hits Dave - remove bullet & dave dead */
-      game->ebullet_px = game->ebullet_py = 0;
+      entity_destroy(e, i);
       game->dave_dead_timer = 30;
     }
   }
 }
 
+/* Add a monster at a grid position, at the start of its level's track.
+   Returns its dense index, -1 if the pool is full */
+int spawn_monster(struct game_state *game, u8 type, u8 x, u8 y)
+{
+  struct entity_pool *e = &game->entities;
+  int i = entity_spawn(e, ENTITY_MONSTER);
+
+  if (i < 0)
+    return -1;
+
+  e->type[i] = type;
+  e->x[i] = x;
+  e->y[i] = y;
+  e->px[i] = x * TILE_SIZE;
+  e->py[i] = y * TILE_SIZE;
+
+  return i;
+}
+
 /* Start a new level */
 void start_level(struct game_state *game)
 {
-  u8 i;
+  /* Usually prefetched while the last level was played */
+  level_require(game->current_level);
+  level_prefetch(game->current_level + 1);
 
   /* Reset dave position */
   restart_level(game);
 
-  /* Deactivate monsters */
-	for (i=0;i<5;i++)
-	{
-		game->monster[i].type = 0;
-		game->monster[i].path_index = 0;
-		game->monster[i].dead_timer = 0;
-		game->monster[i].next_px = 0;
-		game->monster[i].next_py = 0;
-	}
+  /* Every item is back */
+  memset(game->pickups, 0, sizeof(game->pickups));
+  game->pickup_hash = 0;
+
+  /* Remove monsters and bullets left from the last level */
+  entity_clear(&game->entities);
 
   /* Activate monsters based on level
 	   current_level counting starts at 0
@@ -447,103 +700,52 @@ void start_level(struct game_state *game)
 	{
 		case 2:
 		{
-			game->monster[0].type = 89;
-			game->monster[0].monster_px = 44 * TILE_SIZE;
-			game->monster[0].monster_py = 4 * TILE_SIZE;
-
-			game->monster[1].type = 89;
-			game->monster[1].monster_px = 59 * TILE_SIZE;
-			game->monster[1].monster_py = 4 * TILE_SIZE;
+			spawn_monster(game, 89, 44, 4);
+			spawn_monster(game, 89, 59, 4);
 		} break;
 		case 3:
 		{
-			game->monster[0].type = 93;
-			game->monster[0].monster_px = 32 * TILE_SIZE;
-			game->monster[0].monster_py = 2 * TILE_SIZE;
+			spawn_monster(game, 93, 32, 2);
 		} break;
 		case 4:
 		{
-			game->monster[0].type = 97;
-			game->monster[0].monster_px = 15 * TILE_SIZE;
-			game->monster[0].monster_py = 3 * TILE_SIZE;
-			game->monster[1].type = 97;
-			game->monster[1].monster_px = 33 * TILE_SIZE;
-			game->monster[1].monster_py = 3 * TILE_SIZE;
-			game->monster[2].type = 97;
-			game->monster[2].monster_px = 49 * TILE_SIZE;
-			game->monster[2].monster_py = 3 * TILE_SIZE;
+			spawn_monster(game, 97, 15, 3);
+			spawn_monster(game, 97, 33, 3);
+			spawn_monster(game, 97, 49, 3);
 		} break;
 		case 5:
 		{
-			game->monster[0].type = 101;
-			game->monster[0].monster_px = 10 * TILE_SIZE;
-			game->monster[0].monster_py = 8 * TILE_SIZE;
-			game->monster[1].type = 101;
-			game->monster[1].monster_px = 28 * TILE_SIZE;
-			game->monster[1].monster_py = 8 * TILE_SIZE;
-			game->monster[2].type = 101;
-			game->monster[2].monster_px = 45 * TILE_SIZE;
-			game->monster[2].monster_py = 2 * TILE_SIZE;
-			game->monster[3].type = 101;
-			game->monster[3].monster_px = 40 * TILE_SIZE;
-			game->monster[3].monster_py = 8 * TILE_SIZE;
+			spawn_monster(game, 101, 10, 8);
+			spawn_monster(game, 101, 28, 8);
+			spawn_monster(game, 101, 45, 2);
+			spawn_monster(game, 101, 40, 8);
 		} break;
 		case 6:
 		{
-			game->monster[0].type = 105;
-			game->monster[0].monster_px = 5 * TILE_SIZE;
-			game->monster[0].monster_py = 2 * TILE_SIZE;
-			game->monster[1].type = 105;
-			game->monster[1].monster_px = 16 * TILE_SIZE;
-			game->monster[1].monster_py = 1 * TILE_SIZE;
-			game->monster[2].type = 105;
-			game->monster[2].monster_px = 46 * TILE_SIZE;
-			game->monster[2].monster_py = 2 * TILE_SIZE;
-			game->monster[3].type = 105;
-			game->monster[3].monster_px = 56 * TILE_SIZE;
-			game->monster[3].monster_py = 3 * TILE_SIZE;
+			spawn_monster(game, 105, 5, 2);
+			spawn_monster(game, 105, 16, 1);
+			spawn_monster(game, 105, 46, 2);
+			spawn_monster(game, 105, 56, 3);
 		} break;
 		case 7:
 		{
-			game->monster[0].type = 109;
-			game->monster[0].monster_px = 53 * TILE_SIZE;
-			game->monster[0].monster_py = 5 * TILE_SIZE;
-			game->monster[1].type = 109;
-			game->monster[1].monster_px = 72 * TILE_SIZE;
-			game->monster[1].monster_py = 2 * TILE_SIZE;
-			game->monster[2].type = 109;
-			game->monster[2].monster_px = 84 * TILE_SIZE;
-			game->monster[2].monster_py = 1 * TILE_SIZE;
+			spawn_monster(game, 109, 53, 5);
+			spawn_monster(game, 109, 72, 2);
+			spawn_monster(game, 109, 84, 1);
 		} break;
 		case 8:
 		{
-			game->monster[0].type = 113;
-			game->monster[0].monster_px = 35 * TILE_SIZE;
-			game->monster[0].monster_py = 8 * TILE_SIZE;
-			game->monster[1].type = 113;
-			game->monster[1].monster_px = 41 * TILE_SIZE;
-			game->monster[1].monster_py = 8 * TILE_SIZE;
-			game->monster[2].type = 113;
-			game->monster[2].monster_px = 49 * TILE_SIZE;
-			game->monster[2].monster_py = 8 * TILE_SIZE;
-			game->monster[3].type = 113;
-			game->monster[3].monster_px = 65 * TILE_SIZE;
-			game->monster[3].monster_py = 8 * TILE_SIZE;
+			spawn_monster(game, 113, 35, 8);
+			spawn_monster(game, 113, 41, 8);
+			spawn_monster(game, 113, 49, 8);
+			spawn_monster(game, 113, 65, 8);
 		} break;
 		case 9:
 		{
-			game->monster[0].type = 117;
-			game->monster[0].monster_px = 45 * TILE_SIZE;
-			game->monster[0].monster_py = 8 * TILE_SIZE;
-			game->monster[1].type = 117;
-			game->monster[1].monster_px = 51 * TILE_SIZE;
-			game->monster[1].monster_py = 2 * TILE_SIZE;
-			game->monster[2].type = 117;
-			game->monster[2].monster_px = 65 * TILE_SIZE;
-			game->monster[2].monster_py = 3 * TILE_SIZE;
-			game->monster[3].type = 117;
-			game->monster[3].monster_px = 82 * TILE_SIZE;
-			game->monster[3].monster_py = 5 * TILE_SIZE;
+			spawn_monster(game, 117, 45, 8);
+			spawn_monster(game, 117, 51, 2);
+			spawn_monster(game, 117, 65, 3);
+			spawn_monster(game, 117, 82, 5);
 		} break;
 	}
 
@@ -552,8 +754,7 @@ void start_level(struct game_state *game)
   game->dave_py = game->dave_y * TILE_SIZE;
 
   /* Reset various state variables at the start of each level */
-  game->dave_jetpack = 0;
-  game->dave_fire = 0;
+  game->dave_action &= ~(DAVE_JETPACK | DAVE_FIRE);
   game->trophy = 0;
   game->gun = 0;
   game->jetpack = 0;
@@ -563,10 +764,6 @@ void start_level(struct game_state *game)
   game->view_y = 0;
   game->jump_timer = 0;
   game->last_dir = 0;
-  game->dbullet_px = 0;
-  game->dbullet_py = 0;
-  game->ebullet_px = 0;
-  game->ebullet_py = 0;
 }
 
 /* Check if keyboard input is valid. If so, set action variable */
@@ -577,42 +774,41 @@ void verify_input(struct game_state *game)
     return;
   
   /* Dave can move right if there are no obstructions */
-  if (game->try_right && game->collision_point[2] && game->collision_point[3])
-    game->dave_right = 1;
+  if ((game->try_input & INPUT_RIGHT) && game->collision_point[2] && game->collision_point[3])
+    game->dave_action |= DAVE_RIGHT;
 
   /* Dave can move left if there are no obstructions */
-  if (game->try_left && game->collision_point[6] && game->collision_point[7])
-    game->dave_left = 1;
+  if ((game->try_input & INPUT_LEFT) && game->collision_point[6] && game->collision_point[7])
+    game->dave_action |= DAVE_LEFT;
 
   /* Dave can jump if he's on the ground and not using the jeypack, also no double-jumping*/
-  if (game->try_jump && game->on_ground && !game->dave_jump && !game->dave_jetpack && !game->can_climb && game->collision_point[0] && game->collision_point[1])
-		game->dave_jump = 1;
+  if ((game->try_input & INPUT_JUMP) && game->on_ground && !(game->dave_action & (DAVE_JUMP | DAVE_JETPACK)) && !game->can_climb && game->collision_point[0] && game->collision_point[1])
+		game->dave_action |= DAVE_JUMP;
 
   /* Dave should climb rather than jump if he's in front of a climbable tile */
-	if (game->try_jump && game->can_climb)
+	if ((game->try_input & INPUT_JUMP) && game->can_climb)
 	{
-		game->dave_up = 1;
-		game->dave_climb = 1;
+		game->dave_action |= DAVE_UP | DAVE_CLIMB;
 	}
 
     /* Dave and fire if he has the gun and isn't already firing */
-  if (game->try_fire && game->gun && !game->dbullet_py && !game->dbullet_px)
-    game->dave_fire = 1;
+  if ((game->try_input & INPUT_FIRE) && game->gun && game->entities.live[ENTITY_DBULLET] < DBULLET_MAX)
+    game->dave_action |= DAVE_FIRE;
 
   /* Dave can toggle the jetpack if he has one and he didn't recently toggle it */
-  if (game->try_jetpack && game->jetpack && !game->jetpack_delay)
+  if ((game->try_input & INPUT_JETPACK) && game->jetpack && !game->jetpack_delay)
   {
-    game->dave_jetpack = !game->dave_jetpack;
+    game->dave_action ^= DAVE_JETPACK;
     game->jetpack_delay = 10;
   }
 
   /* Dave can move downward if he is climbing or has a jetpack */
-	if (game->try_down && (game->dave_jetpack || game->dave_climb) && game->collision_point[4] && game->collision_point[5])
-		game->dave_down = 1;
+	if ((game->try_input & INPUT_DOWN) && (game->dave_action & (DAVE_JETPACK | DAVE_CLIMB)) && game->collision_point[4] && game->collision_point[5])
+		game->dave_action |= DAVE_DOWN;
 
   /* Dave can move up if he has jetpack */
-  if (game->try_jump && game->dave_jetpack && game->collision_point[0] && game->collision_point[1])
-    game->dave_up = 1;
+  if ((game->try_input & INPUT_JUMP) && (game->dave_action & DAVE_JETPACK) && game->collision_point[0] && game->collision_point[1])
+    game->dave_action |= DAVE_UP;
 }
 
 /* Move dave around the world */
@@ -629,39 +825,39 @@ void move_dave(struct game_state *game)
 	}
 
   /* Move Dave right */
-  if (game->dave_right)
+  if (game->dave_action & DAVE_RIGHT)
   {
     game->dave_px += 2;
     game->last_dir = 1;
     game->dave_tick++;
-    game->dave_right = 0;
+    game->dave_action &= ~DAVE_RIGHT;
   }
 
   /* Move Dave left */
-  if (game->dave_left)
+  if (game->dave_action & DAVE_LEFT)
   {
     game->dave_px -= 2;
     game->last_dir = -1;
     game->dave_tick++;
-    game->dave_left = 0;
+    game->dave_action &= ~DAVE_LEFT;
   }
 
   /* Move Dave down */
-  if (game->dave_down)
+  if (game->dave_action & DAVE_DOWN)
   {
     game->dave_py += 2;
-    game->dave_down = 0;
+    game->dave_action &= ~DAVE_DOWN;
   }
 
   /* Move Dave up */
-  if (game->dave_up)
+  if (game->dave_action & DAVE_UP)
   {
     game->dave_py -= 2;
-    game->dave_up = 0;
+    game->dave_action &= ~DAVE_UP;
   }
 
   /* Make Dave jump */
-  if (game->dave_jump)
+  if (game->dave_action & DAVE_JUMP)
   {
     if (!game->jump_timer)
     {
@@ -685,100 +881,65 @@ void move_dave(struct game_state *game)
 
     /* Stop jump if timer is zero */
     if (!game->jump_timer)
-      game->dave_jump = 0;
+      game->dave_action &= ~DAVE_JUMP;
   }
 
   /* Fire Dave's gun */
-  if (game->dave_fire)
+  if (game->dave_action & DAVE_FIRE)
   {
-    game->dbullet_dir = game->last_dir;
+    struct entity_pool *e = &game->entities;
+    int i = entity_spawn(e, ENTITY_DBULLET);
 
-    /* Bullet should match Dave's direction */
-    if (!game->dbullet_dir)
-      game->dbullet_dir = 1;
+    if (i >= 0)
+    {
+      e->dir[i] = game->last_dir;
+
+      /* Bullet should match Dave's direction */
+      if (!e->dir[i])
+        e->dir[i] = 1;
 
-    /* Bullet should start in front of Dave */
-    if (game->dbullet_dir == 1)
-      game->dbullet_px = game->dave_px + 18;
+      /* Bullet should start in front of Dave */
+      if (e->dir[i] == 1)
+        e->px[i] = game->dave_px + 18;
 
-    if (game->dbullet_dir == -1)
-      game->dbullet_px = game->dave_px - 8;
+      if (e->dir[i] == -1)
+        e->px[i] = game->dave_px - 8;
 
-    game->dbullet_py = game->dave_py + 8;
+      e->py[i] = game->dave_py + 8;
+    }
 
     /* Reset fire flag */
-    game->dave_fire = 0;
+    game->dave_action &= ~DAVE_FIRE;
   }
 }
 
-/* Move monsters along their predefined path
-  Path data - https://moddingwiki.shikadi.net/wiki/Dangerous_Dave_Level_format */
+/* Move monsters along their level's compiled path track */
 void move_monsters(struct game_state *game)
 {
-  u8 i, j;
+  const struct monster_track *track = &tracks[game->current_level];
+  struct entity_pool *e = &game->entities;
+  u16 i, step;
+  u8 j;
 
-  for (i = 0; i < 5; i++)
+  for (i = 0; i < e->count; i++)
   {
-    struct monster_state *m;
-    m = &game->monster[i];
-
     /* Only move if monster is alive */
-    if (m->type && !m->dead_timer)
+    if (e->kind[i] == ENTITY_MONSTER && !e->dead_timer[i])
     {
       /* Move monster twice each tick. Hack to match speed of original game */
 			for (j=0;j<2;j++)
 			{
-        /* Check if monster is at end of path */
-        if (!m->next_px && !m->next_py)
-        {
-          /* Get the next path waypoint */
-          m->next_px = game->level[game->current_level].path[m->path_index];
-          m->next_py = game->level[game->current_level].path[m->path_index + 1];
-
-          /* x and y is stored in pair */
-          m->path_index += 2;
-        }
-
-        /* End of path = 0xEA -- reset monster to start of path */
-        if (m->next_px == (signed char)0xEA && m->next_py == (signed char)0xEA)
-        {
-          m->next_px = game->level[game->current_level].path[0];
-          m->next_py = game->level[game->current_level].path[1];
-          m->path_index = 2;
-        }
-
-        /* Move monster left */
-        if (m->next_px < 0)
-        {
-          m->monster_px -= 1;
-          m->next_px++;
-        }
-
-        /* Move monster right */
-        if (m->next_px > 0)
-        {
-          m->monster_px += 1;
-          m->next_px--;
-        }
-
-        /* Move monster up */
-        if (m->next_py < 0)
-        {
-          m->monster_py -= 1;
-          m->next_py++;
-        }
-
-        /* Move monster down */
-        if (m->next_py > 0)
-        {
-          m->monster_py += 1;
-          m->next_py--;
-        }
+        step = e->path_step[i] + 1;
+        e->px[i] += track->x[step] - track->x[step - 1];
+        e->py[i] += track->y[step] - track->y[step - 1];
+
+        /* End of track -- carry on from where the path loops */
+        e->path_step[i] = step == track->loop_end ? track->loop_start : step;
       }
 
       /* Update monster grid position */
-      m->monster_x = m->monster_px / TILE_SIZE;
-      m->monster_y = m->monster_py / TILE_SIZE;
+      e->x[i] = e->px[i] / TILE_SIZE;
+      e->y[i] = e->py[i] / TILE_SIZE;
     }
   }
 }
@@ -786,33 +947,45 @@ void move_monsters(struct game_state *game)
 /* Monster shooting */
 void fire_monsters(struct game_state *game)
 {
-  int i;
+  struct entity_pool *e = &game->entities;
+  struct spatial_grid grid;
+  u16 seen[ENTITY_MAX];
+  int shooter = -1;
+  int b;
+  u32 count, i;
+
+  if (e->live[ENTITY_EBULLET] >= EBULLET_MAX || !e->live[ENTITY_MONSTER])
+    return;
 
-  if (!game->ebullet_px && !game->ebullet_py)
+  /* Monster's shoot if they're active and visible, the last one gets the shot.
+     Visible is the view's 20 columns, whatever the row */
+  spatial_build(&grid, e, ENTITY_MONSTER);
+  count = spatial_query(&grid, game->view_x, 0, game->view_x + 19, 0xFF, seen);
+  for (i = 0; i < count; i++)
   {
-    for (i = 0; i < 5; i++)
-    {
-      /* Monster's shoot if they're active and visible */
-      if (game->monster[i].type && is_visible(game, game->monster[i].monster_px) && !game->monster[i].dead_timer)
-      {
-        /* Shoot towards Dave */
-        game->ebullet_dir = game->dave_px < game->monster[i].monster_px ? -1 : 1;
+    if (!e->dead_timer[seen[i]] && seen[i] > shooter)
+      shooter = seen[i];
+  }
 
-        if (!game->ebullet_dir)
-          game->ebullet_dir = 1;
+  if (shooter < 0)
+    return;
 
-        /* Start bullet in front of monster */
-        if (game->ebullet_dir == 1)
-          game->ebullet_px = game->monster[i].monster_px + 18;
+  b = entity_spawn(e, ENTITY_EBULLET);
+  if (b < 0)
+    return;
 
-        if (game->ebullet_dir == -1)
-          game->ebullet_px = game->monster[i].monster_px - 8;
+  /* Shoot towards Dave */
+  e->dir[b] = game->dave_px < e->px[shooter] ? -1 : 1;
 
-        /* vertical align it to the center of the title */
-        game->ebullet_py = game->monster[i].monster_py + 8;
-      }
-    }
-  }
+  /* Start bullet in front of monster */
+  if (e->dir[b] == 1)
+    e->px[b] = e->px[shooter] + 18;
+
+  if (e->dir[b] == -1)
+    e->px[b] = e->px[shooter] - 8;
+
+  /* vertical align it to the center of the title */
+  e->py[b] = e->py[shooter] + 8;
 }
 
 /* Scroll the screen when Dave is near the edge
@@ -856,7 +1029,7 @@ void scroll_screen(struct game_state *game)
 void apply_gravity(struct game_state *game)
 {
   /* If he's not jumping or on the ground, apply gravity */
-  if (!game->dave_jump && !game->on_ground && !game->dave_jetpack && !game->dave_climb)
+  if (!(game->dave_action & (DAVE_JUMP | DAVE_JETPACK | DAVE_CLIMB)) && !game->on_ground)
   {
     /* If above is clear, move dave up*/
     if (is_clear(game, game->dave_px + 4, game->dave_py + 17, 1))
@@ -878,7 +1051,11 @@ void apply_gravity(struct game_state *game)
 /* Handle level-wide events */
 void update_level(struct game_state *game)
 {
-  u8 i;
+  struct entity_pool *e = &game->entities;
+  struct spatial_grid grid;
+  u16 hits[ENTITY_MAX];
+  u32 count, j;
+  u16 i;
 
   game->tick++;
 
@@ -887,11 +1064,11 @@ void update_level(struct game_state *game)
     game->jetpack_delay--;
 
   /* Decrement Dave's jetpack fuel */
-  if (game->dave_jetpack)
+  if (game->dave_action & DAVE_JETPACK)
   {
     game->jetpack--;
     if (!game->jetpack)
-      game->dave_jetpack = 0;
+      game->dave_action &= ~DAVE_JETPACK;
   }
   
   /* Check if Dave completes level */
@@ -932,27 +1109,30 @@ void update_level(struct game_state *game)
   }
 
   /* Check monster timers */
-  for (i = 0; i < 5; i++)
+  for (i = 0; i < e->count; i++)
   {
-    if (game->monster[i].dead_timer)
+    if (e->kind[i] == ENTITY_MONSTER && e->dead_timer[i])
     {
-      game->monster[i].dead_timer--;
-      if (!game->monster[i].dead_timer)
-        game->monster[i].type = 0;
+      e->dead_timer[i]--;
+      if (!e->dead_timer[i])
+        entity_destroy(e, i);
     }
-    else
+  }
+
+  /* Check Dave/Monster collisions, dying monsters are harmless */
+  spatial_build(&grid, e, ENTITY_MONSTER);
+  count = spatial_query(&grid, game->dave_x, game->dave_y, game->dave_x, game->dave_y, hits);
+  for (j = 0; j < count; j++)
+  {
+    if (!e->dead_timer[hits[j]])
     {
-      /* Check Dave/Monster collisions */
-      if (game->monster[i].type)
-      {
-        if (game->monster[i].monster_x == game->dave_x && game->monster[i].monster_y == game->dave_y)
-        {
-          game->monster[i].dead_timer = 30;
-          game->dave_dead_timer = 30;
-        }
-      }
+      e->dead_timer[hits[j]] = 30;
+      game->dave_dead_timer = 30;
     }
   }
+
+  /* Drop what was destroyed this tick */
+  entity_compact(e);
 }
 
 void restart_level(struct game_state *game)
@@ -978,27 +1158,17 @@ void restart_level(struct game_state *game)
 }
 
 /* Update frame animation based on tick timer, tile's type count and tile position*/
-u8 update_frame(struct game_state *game, u8 tile, u8 salt)
+u8 update_frame(struct render_state *game, u8 tile, u8 salt)
 {
   /* figure out how many frames there are. create a modular ring
     using the initial tile as the anchor.  */
-  u8 mod;
-
-  switch (tile)
-	{
-		case 6: mod = 4; break;
-		case 10: mod = 5; break;
-		case 25: mod = 4; break;
-		case 36: mod = 5; break;
-		case 129: mod = 4; break;
-		default: mod = 1; break;
-	}
+  u8 mod = tile_props[tile].frames;
 
   return tile + (salt + game->tick / 5) % mod;
 }
 
 /* Render the world */
-void draw_world(struct game_state *game, struct game_assets *assets, SDL_Renderer *renderer)
+void draw_world(struct render_state *game, struct game_assets *assets, SDL_Renderer *renderer)
 {
   SDL_Rect dest;
   u8 tile_index;
@@ -1015,7 +1185,7 @@ void draw_world(struct game_state *game, struct game_assets *assets, SDL_Rendere
     for (i = 0; i < 20; i++)
     {
       dest.x = i * TILE_SIZE;
-      tile_index = game->level[game->current_level].tiles[j * 100 + game->view_x + i];
+      tile_index = game->tiles[j * 100 + game->view_x + i];
 
       /* Update the frame of the tile */
       tile_index = update_frame(game, tile_index, i);
@@ -1025,7 +1195,7 @@ void draw_world(struct game_state *game, struct game_assets *assets, SDL_Rendere
 }
 
 /* Render dave */
-void draw_dave(struct game_state *game, struct game_assets *assets, SDL_Renderer *renderer)
+void draw_dave(struct render_state *game, struct game_assets *assets, SDL_Renderer *renderer)
 {
   SDL_Rect dest;
   u8 tile_index;
@@ -1063,74 +1233,79 @@ void draw_dave(struct game_state *game, struct game_assets *assets, SDL_Renderer
 }
 
 /* Render Dave's bullets */
-void draw_dave_bullet(struct game_state *game, struct game_assets *assets, SDL_Renderer *renderer)
+void draw_dave_bullet(struct render_state *game, struct game_assets *assets, SDL_Renderer *renderer)
 {
+  const struct entity_pool *e = &game->entities;
   SDL_Rect dest;
   u8 tile_index;
+  u16 i;
 
-  /* If no bullet, exit */
-  if (!game->dbullet_px || !game->dbullet_py)
-    return;
+  for (i = 0; i < e->count; i++)
+  {
+    if (e->kind[i] != ENTITY_DBULLET || !e->px[i] || !e->py[i])
+      continue;
 
-  dest.x = game->dbullet_px - game->view_x * TILE_SIZE;
-  dest.y = TILE_SIZE + game->dbullet_py;
-  dest.w = 12;
-  dest.h = 3;
-  tile_index = game->dbullet_dir > 0 ? 127 : 128;
+    dest.x = e->px[i] - game->view_x * TILE_SIZE;
+    dest.y = TILE_SIZE + e->py[i];
+    dest.w = 12;
+    dest.h = 3;
+    tile_index = e->dir[i] > 0 ? 127 : 128;
 
-  SDL_RenderCopy(renderer, assets->graphics_tiles[tile_index], NULL, &dest);
+    SDL_RenderCopy(renderer, assets->graphics_tiles[tile_index], NULL, &dest);
+  }
 }
 
 /* Render Monster bullets */
-void draw_monster_bullet(struct game_state *game, struct game_assets *assets, SDL_Renderer *renderer)
+void draw_monster_bullet(struct render_state *game, struct game_assets *assets, SDL_Renderer *renderer)
 {
+  const struct entity_pool *e = &game->entities;
   SDL_Rect dest;
   u8 tile_index;
+  u16 i;
 
-  /* If no bullet, exit */
-  if (!game->ebullet_px || !game->ebullet_py)
-    return;
+  for (i = 0; i < e->count; i++)
+  {
+    if (e->kind[i] != ENTITY_EBULLET || !e->px[i] || !e->py[i])
+      continue;
 
-  dest.x = game->ebullet_px - game->view_x * TILE_SIZE;
-  dest.y = TILE_SIZE + game->ebullet_py;
-  dest.w = 12;
-  dest.h = 3;
-  tile_index = game->ebullet_dir > 0 ? 121 : 124;
+    dest.x = e->px[i] - game->view_x * TILE_SIZE;
+    dest.y = TILE_SIZE + e->py[i];
+    dest.w = 12;
+    dest.h = 3;
+    tile_index = e->dir[i] > 0 ? 121 : 124;
 
-  SDL_RenderCopy(renderer, assets->graphics_tiles[tile_index], NULL, &dest);
+    SDL_RenderCopy(renderer, assets->graphics_tiles[tile_index], NULL, &dest);
+  }
 }
 
 /* Render monster */
-void draw_monsters(struct game_state *game, struct game_assets *assets, SDL_Renderer *renderer)
+void draw_monsters(struct render_state *game, struct game_assets *assets, SDL_Renderer *renderer)
 {
+  const struct entity_pool *e = &game->entities;
   SDL_Rect dest;
   u8 tile_index;
-  u8 i;
+  u16 i;
 
   /* loop through all monsters */
-  for (i = 0; i < 5; i++)
+  for (i = 0; i < e->count; i++)
   {
+    if (e->kind[i] != ENTITY_MONSTER)
+      continue;
 
-    struct monster_state *m;
-    m = &game->monster[i];
-
-    if (m->type)
-    {
-      dest.x = m->monster_px - game->view_x * TILE_SIZE;
-      dest.y = TILE_SIZE + m->monster_py;
-      dest.w = 20;
-      dest.h = 16;
+    dest.x = e->px[i] - game->view_x * TILE_SIZE;
+    dest.y = TILE_SIZE + e->py[i];
+    dest.w = 20;
+    dest.h = 16;
 
-      tile_index = m->dead_timer ? 129 : m->type;
-      tile_index += (game->tick / 3) % 4;
+    tile_index = e->dead_timer[i] ? 129 : e->type[i];
+    tile_index += (game->tick / 3) % 4;
 
-      SDL_RenderCopy(renderer, assets->graphics_tiles[tile_index], NULL, &dest);
-    }
+    SDL_RenderCopy(renderer, assets->graphics_tiles[tile_index], NULL, &dest);
   }
 }
 
 /* Render all UI elements */
-void draw_ui(struct game_state *game, struct game_assets *assets, SDL_Renderer *renderer)
+void draw_ui(struct render_state *game, struct game_assets *assets, SDL_Renderer *renderer)
 {
   SDL_Rect dest;
 	u8 i;
@@ -1254,7 +1429,7 @@ u8 is_clear(struct game_state *game, u16 px, u16 py, u8 is_dave)
 {
   u8 grid_x;
   u8 grid_y;
-  u8 type;
+  u8 flags;
 
   grid_x = px / TILE_SIZE;
   grid_y = py / TILE_SIZE;
@@ -1263,61 +1438,39 @@ u8 is_clear(struct game_state *game, u16 px, u16 py, u8 is_dave)
   if (grid_x > 99 || grid_y > 9)
     return 1;
 
-  type = game->level[game->current_level].tiles[grid_y * 100 + grid_x];
-
-  if (type == 1) { return 0; }
-	if (type == 3) { return 0; }
-	if (type == 5) { return 0; }
-	if (type == 15) { return 0; }
-	if (type == 16) { return 0; }
-	if (type == 17) { return 0; }
-	if (type == 18) { return 0; }
-	if (type == 19) { return 0; }
-	if (type == 21) { return 0; }
-	if (type == 22) { return 0; }
-	if (type == 23) { return 0; }
-	if (type == 24) { return 0; }
-	if (type == 29) { return 0; }
-	if (type == 30) { return 0; }
-
-  if (is_dave)
+  flags = tile_props[level_tile(game, grid_y * 100 + grid_x)].flags;
+
+  if (flags & TILE_SOLID)
+    return 0;
+
+  /* Dave-only collision checks (door, pickups, hazards) */
+  if (is_dave && (flags & TILE_TOUCH))
   {
-    /* Dave-only collision checks (pickups) */
-    switch (type)
-    {
-    case 2:
+    if (flags & TILE_DOOR)
       game->check_door = 1;
-      break;
-    case 4:  /* jetpack */
-    case 10: /* trophy */
-    case 20: /* gun */
-    case 47:
-    case 48:
-    case 49:
-    case 50:
-    case 51:
-    case 52:
+
+    if (flags & TILE_PICKUP)
     {
       game->check_pickup_x = grid_x;
       game->check_pickup_y = grid_y;
     }
-    break;
-    case 6:
-    case 25:
-    case 36:
-    {
-      if (!game->dave_dead_timer)
-        game->dave_dead_timer = 30;
-    }
-    break;
-    default:
-      break;
-    }
+
+    if ((flags & TILE_HAZARD) && !game->dave_dead_timer)
+      game->dave_dead_timer = 30;
   }
 
   return 1;
 }
 
+/* Tile at index (y * 100 + x) of the current level, 0 once picked up */
+inline u8 level_tile(const struct game_state *game, u16 index)
+{
+  if (game->pickups[index / 8] & (1 << index % 8))
+    return 0;
+
+  return levels[game->current_level].tiles[index];
+}
+
 /* Checks if an input pixel position is currently visible */
 inline u8 is_visible(struct game_state *game, u16 px)
 {
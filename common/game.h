@@ -5,15 +5,52 @@
 #include <SDL.h>
 #include "variables.h"
 
+/* Input flags latched by the render thread, applied once per tick */
+#define INPUT_RIGHT 0x01
+#define INPUT_LEFT 0x02
+#define INPUT_JUMP 0x04
+#define INPUT_DOWN 0x08
+#define INPUT_FIRE 0x10
+#define INPUT_JETPACK 0x20
+#define INPUT_REWIND 0x40  /* Held to step back in time, never reaches step_game */
+#define INPUT_KEYS 0x3F    /* Everything step_game acts on */
+
+/* Moves verify_input accepted, game_state.dave_action */
+#define DAVE_RIGHT 0x01
+#define DAVE_LEFT 0x02
+#define DAVE_JUMP 0x04
+#define DAVE_DOWN 0x08
+#define DAVE_FIRE 0x10
+#define DAVE_JETPACK 0x20
+#define DAVE_CLIMB 0x40
+#define DAVE_UP 0x80
+
+/* Bullets in flight at once, one each in the original game */
+#define DBULLET_MAX 1
+#define EBULLET_MAX 1
+
+/* Indexed by level number. Loaded once, by the first start_level of
+   each (see levelcache.h), read-only after. Shared by every
+   game_state, pickups are tracked per game */
+extern struct dave_level levels[10];
+extern struct monster_track tracks[10];
+
 /* Forward declarations */
+struct replay;
+struct autosave;
+struct netplay;
+
 void init_game(struct game_state *);
 void init_sdl(SDL_Window **, SDL_Renderer **);
-void init_assets(struct game_assets *, SDL_Renderer *);
+int load_level(struct dave_level *, int);
+void compile_track(struct monster_track *, const struct dave_level *);
 void start_level(struct game_state *);
-void run_game_loop(struct game_state *, SDL_Renderer *, struct game_assets *);
+int spawn_monster(struct game_state *, u8, u8, u8);
+void run_game_loop(struct game_state *, SDL_Renderer *, struct game_assets *, struct replay *, struct autosave *, struct netplay *);
 
-void check_input(struct game_state *);
+void apply_input(struct game_state *, u8);
 void update_game(struct game_state *);
+void step_game(struct game_state *, u8);
 
 void check_collision(struct game_state *);
 void clear_input(struct game_state *);
@@ -29,16 +66,17 @@ void apply_gravity(struct game_state *);
 void update_level(struct game_state *);
 void restart_level(struct game_state *);
 
-void render(struct game_state *, SDL_Renderer *, struct game_assets *);
-u8 update_frame(struct game_state *, u8, u8);
+void render(struct render_state *, SDL_Renderer *, struct game_assets *);
+u8 update_frame(struct render_state *, u8, u8);
 
-void draw_world(struct game_state *, struct game_assets *, SDL_Renderer *);
-void draw_dave(struct game_state *, struct game_assets *, SDL_Renderer *);
-void draw_dave_bullet(struct game_state *, struct game_assets *, SDL_Renderer *);
-void draw_monster_bullet(struct game_state *, struct game_assets *, SDL_Renderer *);
-void draw_monsters(struct game_state *, struct game_assets *, SDL_Renderer *);
-void draw_ui(struct game_state *, struct game_assets *, SDL_Renderer *);
+void draw_world(struct render_state *, struct game_assets *, SDL_Renderer *);
+void draw_dave(struct render_state *, struct game_assets *, SDL_Renderer *);
+void draw_dave_bullet(struct render_state *, struct game_assets *, SDL_Renderer *);
+void draw_monster_bullet(struct render_state *, struct game_assets *, SDL_Renderer *);
+void draw_monsters(struct render_state *, struct game_assets *, SDL_Renderer *);
+void draw_ui(struct render_state *, struct game_assets *, SDL_Renderer *);
 
+u8 level_tile(const struct game_state *, u16);
 u8 is_clear(struct game_state *, u16, u16, u8);
 u8 is_visible(struct game_state *, u16);
 void add_score(struct game_state *, u16);
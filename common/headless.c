@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+#include "headless.h"
+#include "entity.h"
+
+void input_script_init(struct input_script *script, u32 seed)
+{
+  script->seed = seed;
+  script->input = 0;
+  script->hold = 0;
+}
+
+/* Input for the next tick. Left is dropped two times out of three so
+   Dave tends to make progress through the level */
+u8 input_script_next(struct input_script *script)
+{
+  u32 r;
+
+  if (script->hold)
+  {
+    script->hold--;
+    return script->input;
+  }
+
+  script->seed = script->seed * 1664525u + 1013904223u;
+  r = script->seed >> 8;
+
+  script->input = (u8)(r & 0x3F);
+  if ((r >> 6) % 3)
+    script->input &= ~INPUT_LEFT;
+  script->hold = (u8)((r >> 8) % 40);
+
+  return script->input;
+}
+
+/* Step a game for a number of ticks, restarting from start whenever it
+   ends (won or out of lives). Returns how many games ended */
+u32 run_headless(struct game_state *game, const struct game_state *start, struct input_script *script, u32 ticks)
+{
+  u32 games = 0;
+  u32 t;
+
+  for (t = 0; t < ticks; t++)
+  {
+    step_game(game, input_script_next(script));
+
+    if (game->quit)
+    {
+      memcpy(game, start, sizeof(struct game_state));
+      games++;
+    }
+  }
+
+  return games;
+}
+
+/* Record one scripted game, up to a number of ticks. Returns the ticks
+   recorded */
+u32 record_headless(struct game_state *game, struct input_script *script, struct replay *replay, u32 ticks)
+{
+  replay_record(replay, game);
+
+  while (replay->tick < ticks && !game->quit)
+    replay_step(replay, game, input_script_next(script));
+
+  return replay->tick;
+}
+
+/* Play a replay back as fast as possible. Returns the ticks played */
+u32 play_headless(struct game_state *game, struct replay *replay)
+{
+  if (replay_start(replay, game))
+    return 0;
+
+  while (!game->quit)
+    replay_step(replay, game, 0);
+
+  return replay->tick;
+}
+
+/* Add a number of monsters at random tiles of the current level, each
+   somewhere along its track, to time the entity stages with more of
+   them than any level has. handles gets each one's handle. Returns how
+   many fit in the pool */
+u32 headless_crowd(struct game_state *game, u32 count, u32 seed, u32 *handles)
+{
+  const struct monster_track *track = &tracks[game->current_level];
+  u8 type = game->current_level < 2 ? 89 : 89 + (game->current_level - 2) * 4;
+  u32 added;
+  int i;
+
+  for (added = 0; added < count; added++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    i = spawn_monster(game, type, (seed >> 8) % 100, (seed >> 16) % 10);
+    if (i < 0)
+      break;
+
+    if (track->loop_end)
+      game->entities.path_step[i] = (seed >> 4) % track->loop_end;
+    handles[added] = entity_handle(&game->entities, (u16)i);
+  }
+
+  return added;
+}
+
+/* How many of the monsters headless_crowd added are still in the game.
+   They are found by handle, shots and compaction move the rest of the
+   pool around. Returns -1 if a handle leads to anything but a monster */
+int headless_crowd_left(const struct game_state *game, const u32 *handles, u32 count)
+{
+  const struct entity_pool *e = &game->entities;
+  int left = 0;
+  int i;
+  u32 k;
+
+  for (k = 0; k < count; k++)
+  {
+    i = entity_index(e, handles[k]);
+    if (i < 0)
+      continue;
+    if (e->kind[i] != ENTITY_MONSTER)
+      return -1;
+    left++;
+  }
+
+  return left;
+}
+
+/* Play a netplay match between two peers over a loopback link, each
+   player on their own input script (seed and seed + 1), until both
+   peers have every input of a number of ticks. worst gets the longest
+   single call into a peer, rollbacks included, in performance counter
+   units. Returns how many of the four games (two per peer) differ from
+   the same script played alone, so 0 means rollback kept them in sync */
+u32 headless_loopback(struct netplay *peers, struct net_loopback *link, const struct game_state *start, u32 seed, u32 ticks, u64 *worst)
+{
+  struct net_transport transport[2];
+  struct input_script script[2];
+  struct game_state *alone;
+  u8 input[2];
+  u8 waiting[2] = {0, 0};
+  u32 sums[2];
+  u32 rounds = 0;
+  u32 wrong = 0;
+  u64 begin, elapsed;
+  u32 p, t;
+
+  *worst = 0;
+  for (p = 0; p < 2; p++)
+  {
+    net_loopback_open(&transport[p], link, (u8)p);
+    netplay_init(&peers[p], start, (u8)p, &transport[p]);
+    input_script_init(&script[p], seed + p);
+  }
+
+  /* Gives up if the link loses nearly everything */
+  while ((peers[0].frame < ticks || peers[1].frame < ticks || peers[0].confirmed < ticks || peers[1].confirmed < ticks) && rounds++ < ticks * 10 + 10000)
+  {
+    for (p = 0; p < 2; p++)
+    {
+      begin = SDL_GetPerformanceCounter();
+      if (peers[p].frame < ticks)
+      {
+        if (!waiting[p])
+          input[p] = input_script_next(&script[p]);
+        waiting[p] = !netplay_advance(&peers[p], input[p]);
+      }
+      else
+        netplay_poll(&peers[p]);
+      elapsed = SDL_GetPerformanceCounter() - begin;
+      if (elapsed > *worst)
+        *worst = elapsed;
+    }
+
+    net_loopback_tick(link);
+  }
+
+  /* The same scripts without the network */
+  alone = (struct game_state *)malloc(sizeof(struct game_state));
+  for (p = 0; p < 2; p++)
+  {
+    memcpy(alone, start, sizeof(struct game_state));
+    input_script_init(&script[p], seed + p);
+    for (t = 0; t < ticks; t++)
+      step_game(alone, input_script_next(&script[p]));
+    sums[p] = state_checksum(alone);
+  }
+  free(alone);
+
+  for (p = 0; p < 2; p++)
+  {
+    wrong += state_checksum(&peers[p].game[0]) != sums[0];
+    wrong += state_checksum(&peers[p].game[1]) != sums[1];
+  }
+
+  return wrong;
+}
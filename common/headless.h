@@ -0,0 +1,28 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "game.h"
+#include "replay.h"
+#include "netplay.h"
+
+/* Scripted stand-in for a player
+ * -holds a random set of keys for a random number of ticks
+ * -same seed gives the same input stream on every platform
+ */
+struct input_script
+{
+  u32 seed;
+  u8 input;
+  u8 hold;
+};
+
+void input_script_init(struct input_script *, u32);
+u8 input_script_next(struct input_script *);
+u32 run_headless(struct game_state *, const struct game_state *, struct input_script *, u32);
+u32 record_headless(struct game_state *, struct input_script *, struct replay *, u32);
+u32 play_headless(struct game_state *, struct replay *);
+u32 headless_crowd(struct game_state *, u32, u32, u32 *);
+int headless_crowd_left(const struct game_state *, const u32 *, u32);
+u32 headless_loopback(struct netplay *, struct net_loopback *, const struct game_state *, u32, u32, u64 *);
+
+#endif // HEADLESS_H
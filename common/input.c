@@ -0,0 +1,267 @@
+#include <string.h>
+#include "input.h"
+#include "profiler.h"
+
+/* Open the first attached game controller, if there is one */
+static void open_pad(struct input_queue *queue)
+{
+  int i;
+
+  for (i = 0; i < SDL_NumJoysticks() && !queue->pad; i++)
+  {
+    if (SDL_IsGameController(i))
+      queue->pad = SDL_GameControllerOpen(i);
+  }
+
+  if (queue->pad)
+    queue->pad_id = SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(queue->pad));
+}
+
+void input_init(struct input_queue *queue)
+{
+  SDL_AtomicSet(&queue->head, 0);
+  SDL_AtomicSet(&queue->tail, 0);
+  SDL_AtomicSet(&queue->missed, 0);
+  SDL_AtomicSet(&queue->current, 0);
+  queue->pad = NULL;
+  queue->pad_id = -1;
+  queue->keys = 0;
+  memset(queue->held_buttons, 0, sizeof(queue->held_buttons));
+  queue->buttons = 0;
+  queue->axes = 0;
+  queue->down = 0;
+  queue->held = 0;
+
+  open_pad(queue);
+}
+
+void input_close(struct input_queue *queue)
+{
+  if (queue->pad)
+    SDL_GameControllerClose(queue->pad);
+  queue->pad = NULL;
+  queue->pad_id = -1;
+}
+
+static u8 key_flag(SDL_Scancode key)
+{
+  switch (key)
+  {
+    case SDL_SCANCODE_RIGHT: return INPUT_RIGHT;
+    case SDL_SCANCODE_LEFT: return INPUT_LEFT;
+    case SDL_SCANCODE_UP: return INPUT_JUMP;
+    case SDL_SCANCODE_DOWN: return INPUT_DOWN;
+    case SDL_SCANCODE_LCTRL: return INPUT_FIRE;
+    case SDL_SCANCODE_LALT: return INPUT_JETPACK;
+    case SDL_SCANCODE_BACKSPACE: return INPUT_REWIND;
+    default: return 0;
+  }
+}
+
+static u8 button_flag(u8 button)
+{
+  switch (button)
+  {
+    case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: return INPUT_RIGHT;
+    case SDL_CONTROLLER_BUTTON_DPAD_LEFT: return INPUT_LEFT;
+    case SDL_CONTROLLER_BUTTON_DPAD_UP: return INPUT_JUMP;
+    case SDL_CONTROLLER_BUTTON_A: return INPUT_JUMP;
+    case SDL_CONTROLLER_BUTTON_DPAD_DOWN: return INPUT_DOWN;
+    case SDL_CONTROLLER_BUTTON_X: return INPUT_FIRE;
+    case SDL_CONTROLLER_BUTTON_B: return INPUT_JETPACK;
+    case SDL_CONTROLLER_BUTTON_BACK: return INPUT_REWIND;
+    default: return 0;
+  }
+}
+
+static void set_flag(u8 *flags, u8 flag, u8 down)
+{
+  if (down)
+    *flags |= flag;
+  else
+    *flags &= ~flag;
+}
+
+/* Two buttons can share a flag (d-pad up and A both jump), so the flags
+   come from every button down rather than the one that changed */
+static void press_button(struct input_queue *queue, u8 button, u8 down)
+{
+  int b;
+
+  if (button >= SDL_CONTROLLER_BUTTON_MAX)
+    return;
+  queue->held_buttons[button] = down;
+
+  queue->buttons = 0;
+  for (b = 0; b < SDL_CONTROLLER_BUTTON_MAX; b++)
+  {
+    if (queue->held_buttons[b])
+      queue->buttons |= button_flag((u8)b);
+  }
+}
+
+/* The left stick works like the d-pad once past the dead zone */
+static void move_stick(struct input_queue *queue, u8 axis, i16 value)
+{
+  u8 less = axis == SDL_CONTROLLER_AXIS_LEFTX ? INPUT_LEFT : INPUT_JUMP;
+  u8 more = axis == SDL_CONTROLLER_AXIS_LEFTX ? INPUT_RIGHT : INPUT_DOWN;
+
+  if (axis != SDL_CONTROLLER_AXIS_LEFTX && axis != SDL_CONTROLLER_AXIS_LEFTY)
+    return;
+
+  set_flag(&queue->axes, less, value < -INPUT_DEADZONE);
+  set_flag(&queue->axes, more, value > INPUT_DEADZONE);
+}
+
+/* Queue a flag change. A full ring means the simulation thread is far
+   behind; keep the press for it instead */
+static void push_event(struct input_queue *queue, u8 flag, u8 down, u64 time)
+{
+  u32 head = (u32)SDL_AtomicGet(&queue->head);
+  u32 tail = (u32)SDL_AtomicGet(&queue->tail);
+  struct input_event *event;
+  int old;
+
+  if (head - tail >= INPUT_RING)
+  {
+    do
+      old = SDL_AtomicGet(&queue->missed);
+    while (!SDL_AtomicCAS(&queue->missed, old, old | INPUT_LOST | (down ? flag : 0)));
+    return;
+  }
+
+  event = &queue->ring[head & (INPUT_RING - 1)];
+  event->time = time;
+  event->flag = flag;
+  event->down = down;
+
+  /* Event contents must be visible before the head is */
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&queue->head, (int)(head + 1));
+}
+
+/* Queue whatever flags changed with the last event, one by one */
+static void push_changes(struct input_queue *queue, u64 time)
+{
+  u8 down = queue->keys | queue->buttons | queue->axes;
+  u8 changed = down ^ queue->down;
+  u8 flag;
+
+  for (flag = 1; changed; flag <<= 1)
+  {
+    if (!(changed & flag))
+      continue;
+    push_event(queue, flag, (down & flag) != 0, time);
+    changed &= ~flag;
+  }
+
+  queue->down = down;
+  SDL_AtomicSet(&queue->current, down);
+}
+
+/* Drain every pending event. Runs on the thread that owns the window */
+void input_poll(struct input_queue *queue, u8 *quit)
+{
+  SDL_Event event;
+  u8 down;
+
+  while (SDL_PollEvent(&event))
+  {
+    switch (event.type)
+    {
+      case SDL_QUIT:
+        *quit = 1;
+        break;
+
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+        if (event.key.repeat)
+          break;
+        down = event.type == SDL_KEYDOWN;
+
+        /* Frame time overlay */
+        if (down && event.key.keysym.scancode == SDL_SCANCODE_F3)
+          profiler_toggle_overlay();
+
+        set_flag(&queue->keys, key_flag(event.key.keysym.scancode), down);
+        break;
+
+      case SDL_CONTROLLERBUTTONDOWN:
+      case SDL_CONTROLLERBUTTONUP:
+        if (event.cbutton.which == queue->pad_id)
+          press_button(queue, event.cbutton.button, event.type == SDL_CONTROLLERBUTTONDOWN);
+        break;
+
+      case SDL_CONTROLLERAXISMOTION:
+        if (event.caxis.which == queue->pad_id)
+          move_stick(queue, event.caxis.axis, event.caxis.value);
+        break;
+
+      case SDL_CONTROLLERDEVICEADDED:
+        open_pad(queue);
+        break;
+
+      case SDL_CONTROLLERDEVICEREMOVED:
+        /* Only the pad in use matters. Let go of everything it held,
+           then take the next one */
+        if (!queue->pad || event.cdevice.which != queue->pad_id)
+          break;
+        input_close(queue);
+        memset(queue->held_buttons, 0, sizeof(queue->held_buttons));
+        queue->buttons = 0;
+        queue->axes = 0;
+        open_pad(queue);
+        break;
+    }
+
+    push_changes(queue, SDL_GetPerformanceCounter());
+  }
+}
+
+/* Fold every event since the last call into one tick. Runs on the
+   simulation thread, once per tick */
+void input_take(struct input_queue *queue, struct input_tick *tick)
+{
+  u32 head = (u32)SDL_AtomicGet(&queue->head);
+  u32 tail = (u32)SDL_AtomicGet(&queue->tail);
+  struct input_event *event;
+  int missed;
+
+  tick->pressed = 0;
+  tick->released = 0;
+  tick->first = 0;
+
+  /* Events up to head are complete */
+  SDL_MemoryBarrierAcquire();
+  for (; tail != head; tail++)
+  {
+    event = &queue->ring[tail & (INPUT_RING - 1)];
+    if (!tick->first)
+      tick->first = event->time;
+
+    if (event->down)
+    {
+      queue->held |= event->flag;
+      tick->pressed |= event->flag;
+    }
+    else
+    {
+      queue->held &= ~event->flag;
+      tick->released |= event->flag;
+    }
+  }
+
+  /* Done reading, the slots can be reused */
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&queue->tail, (int)tail);
+
+  /* Events were lost, catch up with what is down now */
+  missed = SDL_AtomicSet(&queue->missed, 0);
+  if (missed)
+  {
+    tick->pressed |= (u8)missed;
+    queue->held = (u8)SDL_AtomicGet(&queue->current);
+  }
+
+  tick->held = queue->held;
+}
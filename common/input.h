@@ -0,0 +1,64 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "game.h"
+
+#define INPUT_RING 256          /* Flag changes between two ticks, a power of two */
+#define INPUT_DEADZONE 16000    /* Stick travel that counts as a d-pad press */
+#define INPUT_LOST 0x100        /* Set in input_queue::missed once the ring overflowed */
+
+/* A change in one INPUT_* flag, stamped with the performance counter
+   when it was drained from SDL */
+struct input_event
+{
+  u64 time;
+  u8 flag;
+  u8 down;
+};
+
+/* One tick's input, folded from the events since the last tick */
+struct input_tick
+{
+  u8 held;      /* Down once the tick's events are applied */
+  u8 pressed;   /* Went down during the tick */
+  u8 released;  /* Went up during the tick */
+  u64 first;    /* Time of the oldest event, 0 without any */
+};
+
+/* Input handed from the window thread to the simulation thread
+ * -input_poll drains every pending SDL event and pushes each flag
+ *  change to a single producer, single consumer ring
+ * -input_take folds what arrived since the last tick, so a tap that
+ *  goes down and up between two ticks still counts for that tick
+ * -the keyboard and the first game controller set the same flags, a
+ *  flag is down while any key or button mapped to it is
+ * Should the ring fill up, presses are latched into missed and the
+ * next tick picks up the current flags, so no tap is dropped.
+ */
+struct input_queue
+{
+  struct input_event ring[INPUT_RING];
+  SDL_atomic_t head;
+  SDL_atomic_t tail;
+  SDL_atomic_t missed;
+  SDL_atomic_t current;
+
+  /* Window thread only */
+  SDL_GameController *pad;
+  SDL_JoystickID pad_id;
+  u8 keys;
+  u8 held_buttons[SDL_CONTROLLER_BUTTON_MAX];   /* Pad buttons down */
+  u8 buttons;                                    /* Flags they hold */
+  u8 axes;
+  u8 down;
+
+  /* Simulation thread only */
+  u8 held;
+};
+
+void input_init(struct input_queue *);
+void input_poll(struct input_queue *, u8 *);
+void input_take(struct input_queue *, struct input_tick *);
+void input_close(struct input_queue *);
+
+#endif // INPUT_H
@@ -0,0 +1,86 @@
+#include "levelcache.h"
+#include "profiler.h"
+#include "trace.h"
+
+/* Level status */
+#define LEVEL_UNLOADED 0
+#define LEVEL_LOADING 1  /* Claimed by a thread, not ready to read */
+#define LEVEL_READY 2
+
+static SDL_atomic_t level_status[10];
+
+/* Fill in a level this thread has claimed. A level file that fails to
+   open is left empty, as init_game always did */
+static void load(int index)
+{
+  PROFILE(PROF_LOAD_LEVEL, load_level(&levels[index], index));
+  compile_track(&tracks[index], &levels[index]);
+  SDL_AtomicSet(&level_status[index], LEVEL_READY);
+}
+
+static int prefetch(void *data)
+{
+  trace_thread_begin("prefetch");
+  load((int)(size_t)data);
+  trace_thread_end();
+  return 0;
+}
+
+/* Returns once levels[index] and tracks[index] can be read */
+void level_require(int index)
+{
+  if (SDL_AtomicGet(&level_status[index]) == LEVEL_READY)
+    return;
+
+  if (SDL_AtomicCAS(&level_status[index], LEVEL_UNLOADED, LEVEL_LOADING))
+  {
+    load(index);
+    return;
+  }
+
+  /* Another thread or the prefetch has it, a file read away */
+  while (SDL_AtomicGet(&level_status[index]) != LEVEL_READY)
+    SDL_Delay(0);
+}
+
+/* Start loading a level in the background, if nothing has yet */
+void level_prefetch(int index)
+{
+  SDL_Thread *thread;
+
+  if (index < 0 || index > 9)
+    return;
+  if (!SDL_AtomicCAS(&level_status[index], LEVEL_UNLOADED, LEVEL_LOADING))
+    return;
+
+  thread = SDL_CreateThread(prefetch, "prefetch", (void *)(size_t)index);
+  if (thread)
+    SDL_DetachThread(thread);
+  else
+    load(index);
+}
+
+void levels_require_all(void)
+{
+  int j;
+
+  for (j = 0; j < 10; j++)
+    level_require(j);
+}
+
+/* Read a level again after its file changed. Only between ticks, from
+   the thread playing it. Returns 0 if the level was reloaded, 1 if it
+   was not loaded yet or the file could not be read */
+int level_reload(int index)
+{
+  struct dave_level level;
+
+  if (SDL_AtomicGet(&level_status[index]) != LEVEL_READY)
+    return 1;
+  if (load_level(&level, index))
+    return 1;
+
+  levels[index] = level;
+  compile_track(&tracks[index], &levels[index]);
+  return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef LEVELCACHE_H
+#define LEVELCACHE_H
+
+#include "game.h"
+
+/* Loads levels[] and tracks[] as they are needed instead of all ten
+   before the first frame
+ * -start_level requires its level, loading it on the calling thread if
+ *  nothing has, and prefetches the next one on a background thread so
+ *  finishing a level does not wait on the disk
+ * -a level is loaded once by whichever thread gets to it first, others
+ *  wait for it. After that it is read-only, as before, unless a
+ *  level_reload picks up an edited file (see watch.h)
+ * Anything that reads every level (level_hash) requires them all.
+ */
+
+void level_require(int);
+void level_prefetch(int);
+void levels_require_all(void);
+int level_reload(int);
+
+#endif // LEVELCACHE_H
@@ -0,0 +1,650 @@
+#include <string.h>
+#include "lockstep.h"
+#include "tileset.h"
+#include "entity.h"
+#include "spatial.h"
+#include "statehash.h"
+
+/* Each stage below is update_game's stage of the same name rewritten as
+   a loop over lanes. Branches on lane state become selects so the loops
+   vectorize; tile lookups, whose results depend on the lane's own tiles,
+   stay per lane. Keep them in step with game.c, types included: the
+   narrowing and wrap-around of the u8/i16 fields is part of the result.
+   Entity counts differ from lane to lane, so the entity stages loop per
+   lane over that lane's dense entity arrays instead */
+
+/* Copy one lane's fields to or from a game_state, tiles excluded */
+static void copy_lane(struct lockstep *s, u32 k, struct game_state *game, int to_lane)
+{
+  int i;
+
+#define LANE(f) if (to_lane) s->f[k] = game->f; else game->f = s->f[k]
+#define LANE_BIT(f, field, bit) if (to_lane) s->f[k] = (game->field & (bit)) != 0; else if (s->f[k]) game->field |= (bit)
+
+  LANE(quit); LANE(tick); LANE(dave_tick); LANE(current_level);
+  LANE(score); LANE(lives); LANE(view_x); LANE(view_y); LANE(scroll_x);
+  LANE(dave_x); LANE(dave_y); LANE(dave_px); LANE(dave_py);
+  LANE(on_ground); LANE(last_dir); LANE(can_climb);
+  LANE(jump_timer); LANE(dave_dead_timer); LANE(jetpack_delay);
+  LANE(check_pickup_x); LANE(check_pickup_y); LANE(check_door);
+  LANE(trophy); LANE(gun); LANE(jetpack); LANE(pickup_hash);
+
+  /* Lanes keep a byte per flag, game_state packs them */
+  if (!to_lane)
+  {
+    game->try_input = 0;
+    game->dave_action = 0;
+  }
+  LANE_BIT(try_right, try_input, INPUT_RIGHT); LANE_BIT(try_left, try_input, INPUT_LEFT);
+  LANE_BIT(try_jump, try_input, INPUT_JUMP); LANE_BIT(try_down, try_input, INPUT_DOWN);
+  LANE_BIT(try_fire, try_input, INPUT_FIRE); LANE_BIT(try_jetpack, try_input, INPUT_JETPACK);
+  LANE_BIT(dave_right, dave_action, DAVE_RIGHT); LANE_BIT(dave_left, dave_action, DAVE_LEFT);
+  LANE_BIT(dave_jump, dave_action, DAVE_JUMP); LANE_BIT(dave_down, dave_action, DAVE_DOWN);
+  LANE_BIT(dave_fire, dave_action, DAVE_FIRE); LANE_BIT(dave_jetpack, dave_action, DAVE_JETPACK);
+  LANE_BIT(dave_climb, dave_action, DAVE_CLIMB); LANE_BIT(dave_up, dave_action, DAVE_UP);
+
+  for (i = 0; i < 9; i++)
+  {
+    if (to_lane)
+      s->collision_point[i][k] = game->collision_point[i];
+    else
+      game->collision_point[i] = s->collision_point[i][k];
+  }
+
+  if (to_lane)
+  {
+    memcpy(s->pickups[k], game->pickups, sizeof(s->pickups[k]));
+    memcpy(&s->entities[k], &game->entities, sizeof(s->entities[k]));
+  }
+  else
+  {
+    memcpy(game->pickups, s->pickups[k], sizeof(s->pickups[k]));
+    memcpy(&game->entities, &s->entities[k], sizeof(s->entities[k]));
+  }
+
+#undef LANE
+#undef LANE_BIT
+}
+
+/* Give lane k its current level's tiles, pickups removed, and their flags */
+static void set_tiles(struct lockstep *s, u32 k)
+{
+  int i;
+
+  memcpy(s->tiles[k], levels[s->current_level[k]].tiles, sizeof(s->tiles[k]));
+  for (i = 0; i < 1000; i++)
+  {
+    if (s->pickups[k][i / 8] & (1 << i % 8))
+      s->tiles[k][i] = 0;
+    s->flags[k][i] = tile_props[s->tiles[k][i]].flags;
+  }
+}
+
+/* All lanes start as copies of start */
+void lockstep_init(struct lockstep *s, const struct game_state *start, u32 count)
+{
+  u32 k;
+
+  s->count = count > LOCKSTEP_LANES ? LOCKSTEP_LANES : count;
+  memcpy(&s->scratch, start, sizeof(struct game_state));
+
+  for (k = 0; k < s->count; k++)
+    lockstep_load(s, k, start);
+}
+
+/* Put a game_state in lane k */
+void lockstep_load(struct lockstep *s, u32 k, const struct game_state *game)
+{
+  copy_lane(s, k, (struct game_state *)game, 1);
+  set_tiles(s, k);
+}
+
+/* Write lane k to a game_state */
+void lockstep_store(const struct lockstep *s, u32 k, struct game_state *game)
+{
+  copy_lane((struct lockstep *)s, k, game, 0);
+}
+
+/* Run a scalar level function (start_level, restart_level) on one lane */
+static void lane_scalar(struct lockstep *s, u32 k, void (*fn)(struct game_state *))
+{
+  copy_lane(s, k, &s->scratch, 0);
+  fn(&s->scratch);
+  copy_lane(s, k, &s->scratch, 1);
+}
+
+static void lane_add_score(struct lockstep *s, u32 k, u16 new_score)
+{
+  if (s->score[k] / 20000 != ((s->score[k] + new_score) / 20000))
+    s->lives[k]++;
+
+  s->score[k] += new_score;
+}
+
+/* is_clear for lane k */
+static u8 lane_clear(struct lockstep *s, u32 k, u16 px, u16 py, u8 is_dave)
+{
+  u8 grid_x;
+  u8 grid_y;
+  u8 flags;
+
+  grid_x = px / TILE_SIZE;
+  grid_y = py / TILE_SIZE;
+
+  if (grid_x > 99 || grid_y > 9)
+    return 1;
+
+  flags = s->flags[k][grid_y * 100 + grid_x];
+
+  if (flags & TILE_SOLID)
+    return 0;
+
+  if (is_dave && (flags & TILE_TOUCH))
+  {
+    if (flags & TILE_DOOR)
+      s->check_door[k] = 1;
+
+    if (flags & TILE_PICKUP)
+    {
+      s->check_pickup_x[k] = grid_x;
+      s->check_pickup_y[k] = grid_y;
+    }
+
+    if ((flags & TILE_HAZARD) && !s->dave_dead_timer[k])
+      s->dave_dead_timer[k] = 30;
+  }
+
+  return 1;
+}
+
+/* cond ? a : b, without a branch. cond is 0 or 1 */
+static u8 select_u8(u8 cond, u8 a, u8 b)
+{
+  return (a & (u8)-cond) | (b & (u8)(cond - 1));
+}
+
+/* cond ? 1 : flag */
+static u8 set_if(u8 flag, u8 cond)
+{
+  return select_u8(cond, 1, flag);
+}
+
+static void apply_input_lanes(struct lockstep *s, const u8 *input)
+{
+  u32 k;
+
+  for (k = 0; k < s->count; k++)
+  {
+    s->try_right[k] = (input[k] & INPUT_RIGHT) ? 1 : s->try_right[k];
+    s->try_left[k] = (input[k] & INPUT_LEFT) ? 1 : s->try_left[k];
+    s->try_jump[k] = (input[k] & INPUT_JUMP) ? 1 : s->try_jump[k];
+    s->try_down[k] = (input[k] & INPUT_DOWN) ? 1 : s->try_down[k];
+    s->try_fire[k] = (input[k] & INPUT_FIRE) ? 1 : s->try_fire[k];
+    s->try_jetpack[k] = (input[k] & INPUT_JETPACK) ? 1 : s->try_jetpack[k];
+  }
+}
+
+static void check_collision_lanes(struct lockstep *s)
+{
+  u32 k;
+  u8 grid_x, grid_y;
+  u8 flags;
+
+  for (k = 0; k < s->count; k++)
+  {
+    s->collision_point[0][k] = lane_clear(s, k, s->dave_px[k] + 4, s->dave_py[k] - 1, 1);
+    s->collision_point[1][k] = lane_clear(s, k, s->dave_px[k] + 10, s->dave_py[k] - 1, 1);
+    s->collision_point[2][k] = lane_clear(s, k, s->dave_px[k] + 11, s->dave_py[k] + 4, 1);
+    s->collision_point[3][k] = lane_clear(s, k, s->dave_px[k] + 11, s->dave_py[k] + 12, 1);
+    s->collision_point[4][k] = lane_clear(s, k, s->dave_px[k] + 10, s->dave_py[k] + 16, 1);
+    s->collision_point[5][k] = lane_clear(s, k, s->dave_px[k] + 4, s->dave_py[k] + 16, 1);
+    s->collision_point[6][k] = lane_clear(s, k, s->dave_px[k] + 3, s->dave_py[k] + 12, 1);
+    s->collision_point[7][k] = lane_clear(s, k, s->dave_px[k] + 3, s->dave_py[k] + 4, 1);
+
+    s->on_ground[k] = ((!s->collision_point[4][k] && !s->collision_point[5][k]) || s->dave_climb[k]);
+
+    grid_x = (s->dave_px[k] + 6) / TILE_SIZE;
+    grid_y = (s->dave_py[k] + 8) / TILE_SIZE;
+    flags = grid_x < 100 && grid_y < 10 ? s->flags[k][grid_y * 100 + grid_x] : tile_props[0].flags;
+
+    s->can_climb[k] = (flags & TILE_CLIMB) ? 1 : 0;
+    s->dave_climb[k] = s->can_climb[k] ? s->dave_climb[k] : 0;
+  }
+}
+
+static void pickup_item_lanes(struct lockstep *s)
+{
+  u32 k;
+  u8 grid_x, grid_y;
+  u16 index;
+  const struct tile_property *props;
+
+  for (k = 0; k < s->count; k++)
+  {
+    grid_x = s->check_pickup_x[k];
+    grid_y = s->check_pickup_y[k];
+
+    if (!grid_x || !grid_y)
+      continue;
+
+    props = &tile_props[s->tiles[k][grid_y * 100 + grid_x]];
+
+    if (props->flags & TILE_JETPACK)
+      s->jetpack[k] = 0xFF;
+    if (props->flags & TILE_TROPHY)
+      s->trophy[k] = 1;
+    if (props->flags & TILE_GUN)
+      s->gun[k] = 1;
+    if (props->score)
+      lane_add_score(s, k, props->score);
+
+    index = grid_y * 100 + grid_x;
+    if (!(s->pickups[k][index / 8] & (1 << index % 8)))
+      s->pickup_hash[k] ^= pickup_key(index);
+    s->pickups[k][index / 8] |= 1 << index % 8;
+    s->tiles[k][index] = 0;
+    s->flags[k][index] = tile_props[0].flags;
+    s->check_pickup_x[k] = 0;
+    s->check_pickup_y[k] = 0;
+  }
+}
+
+static void update_dbullet_lanes(struct lockstep *s)
+{
+  struct entity_pool *e;
+  struct spatial_grid grid;
+  u16 hits[ENTITY_MAX];
+  u32 k, count, j;
+  u16 i;
+  u8 grid_x, grid_y;
+
+  for (k = 0; k < s->count; k++)
+  {
+    e = &s->entities[k];
+    if (!e->live[ENTITY_DBULLET])
+      continue;
+
+    spatial_build(&grid, e, ENTITY_MONSTER);
+
+    for (i = 0; i < e->count; i++)
+    {
+      if (e->kind[i] != ENTITY_DBULLET || !e->px[i] || !e->py[i])
+        continue;
+
+      e->px[i] += e->dir[i] * 4;
+      grid_x = e->px[i] / TILE_SIZE;
+      grid_y = e->py[i] / TILE_SIZE;
+
+      if (!lane_clear(s, k, e->px[i], e->py[i], 0) || grid_x - s->view_x[k] < 1 || grid_x - s->view_x[k] > 20)
+      {
+        entity_destroy(e, i);
+        continue;
+      }
+
+      e->px[i] += e->dir[i] * 4;
+
+      count = spatial_query(&grid, grid_x - 1, grid_y - 1, grid_x, grid_y, hits);
+      for (j = 0; j < count; j++)
+      {
+        entity_destroy(e, i);
+        e->dead_timer[hits[j]] = 30;
+        lane_add_score(s, k, 300);
+      }
+    }
+  }
+}
+
+static void update_ebullet_lanes(struct lockstep *s)
+{
+  struct entity_pool *e;
+  u32 k;
+  u16 i;
+  u8 pos_x, grid_x, grid_y;
+
+  for (k = 0; k < s->count; k++)
+  {
+    e = &s->entities[k];
+
+    for (i = 0; i < e->count; i++)
+    {
+      if (e->kind[i] != ENTITY_EBULLET || !e->px[i] || !e->py[i])
+        continue;
+
+      pos_x = e->px[i] / TILE_SIZE;
+      if (!lane_clear(s, k, e->px[i], e->py[i], 0) || !(pos_x - s->view_x[k] < 20 && pos_x - s->view_x[k] >= 0))
+      {
+        entity_destroy(e, i);
+        continue;
+      }
+
+      e->px[i] += e->dir[i] * 4;
+
+      grid_x = e->px[i] / TILE_SIZE;
+      grid_y = e->py[i] / TILE_SIZE;
+
+      if (grid_y == s->dave_y[k] && grid_x == s->dave_x[k])
+      {
+        entity_destroy(e, i);
+        s->dave_dead_timer[k] = 30;
+      }
+    }
+  }
+}
+
+static void verify_input_lanes(struct lockstep *s)
+{
+  u32 k;
+  u8 alive, up, down, left, right, front, toggle;
+
+  /* Flags are 0 or 1, & keeps every load unconditional */
+  for (k = 0; k < s->count; k++)
+  {
+    alive = s->dave_dead_timer[k] == 0;
+    up = (s->collision_point[0][k] != 0) & (s->collision_point[1][k] != 0);
+    right = (s->collision_point[2][k] != 0) & (s->collision_point[3][k] != 0);
+    down = (s->collision_point[4][k] != 0) & (s->collision_point[5][k] != 0);
+    left = (s->collision_point[6][k] != 0) & (s->collision_point[7][k] != 0);
+    front = alive & (s->try_jump[k] != 0) & (s->can_climb[k] != 0);
+
+    s->dave_right[k] = set_if(s->dave_right[k], alive & (s->try_right[k] != 0) & right);
+    s->dave_left[k] = set_if(s->dave_left[k], alive & (s->try_left[k] != 0) & left);
+    s->dave_jump[k] = set_if(s->dave_jump[k], alive & (s->try_jump[k] != 0) & (s->on_ground[k] != 0) & (s->dave_jump[k] == 0) & (s->dave_jetpack[k] == 0) & (s->can_climb[k] == 0) & up);
+    s->dave_up[k] = set_if(s->dave_up[k], front);
+    s->dave_climb[k] = set_if(s->dave_climb[k], front);
+    s->dave_fire[k] = set_if(s->dave_fire[k], alive & (s->try_fire[k] != 0) & (s->gun[k] != 0) & (s->entities[k].live[ENTITY_DBULLET] < DBULLET_MAX));
+
+    toggle = alive & (s->try_jetpack[k] != 0) & (s->jetpack[k] != 0) & (s->jetpack_delay[k] == 0);
+    s->dave_jetpack[k] = select_u8(toggle, s->dave_jetpack[k] == 0, s->dave_jetpack[k]);
+    s->jetpack_delay[k] = select_u8(toggle, 10, s->jetpack_delay[k]);
+
+    s->dave_down[k] = set_if(s->dave_down[k], alive & (s->try_down[k] != 0) & ((s->dave_jetpack[k] != 0) | (s->dave_climb[k] != 0)) & down);
+    s->dave_up[k] = set_if(s->dave_up[k], alive & (s->try_jump[k] != 0) & (s->dave_jetpack[k] != 0) & up);
+  }
+}
+
+static void move_dave_lanes(struct lockstep *s)
+{
+  struct entity_pool *e;
+  u32 k;
+  int i;
+  u8 right, left, jump, clear, start;
+  u8 timer;
+  i8 dir;
+
+  for (k = 0; k < s->count; k++)
+  {
+    s->dave_x[k] = s->dave_px[k] / TILE_SIZE;
+    s->dave_y[k] = s->dave_py[k] / TILE_SIZE;
+
+    /* Wrap to the top of the level */
+    s->dave_py[k] = s->dave_y[k] > 9 ? -16 : s->dave_py[k];
+    s->dave_y[k] = s->dave_y[k] > 9 ? 0 : s->dave_y[k];
+
+    right = s->dave_right[k] != 0;
+    left = s->dave_left[k] != 0;
+    s->dave_px[k] = s->dave_px[k] + 2 * right - 2 * left;
+    s->last_dir[k] = left ? -1 : right ? 1 : s->last_dir[k];
+    s->dave_tick[k] += right + left;
+    s->dave_right[k] = 0;
+    s->dave_left[k] = 0;
+
+    s->dave_py[k] = s->dave_py[k] + 2 * (s->dave_down[k] != 0) - 2 * (s->dave_up[k] != 0);
+    s->dave_down[k] = 0;
+    s->dave_up[k] = 0;
+
+    /* Jump */
+    jump = s->dave_jump[k] != 0;
+    start = jump && !s->jump_timer[k];
+    timer = start ? 30 : s->jump_timer[k];
+    s->last_dir[k] = start ? 0 : s->last_dir[k];
+    clear = jump && s->collision_point[0][k] && s->collision_point[1][k];
+    s->dave_py[k] = s->dave_py[k] - (clear && timer > 16 ? 2 : 0) - (clear && timer >= 12 && timer <= 15 ? 1 : 0);
+    timer = jump ? timer - 1 : timer;
+    s->jump_timer[k] = timer;
+    s->dave_jump[k] = jump && !timer ? 0 : s->dave_jump[k];
+
+    /* Fire, spawning a bullet is rare and per lane */
+    if (s->dave_fire[k])
+    {
+      e = &s->entities[k];
+      i = entity_spawn(e, ENTITY_DBULLET);
+      if (i >= 0)
+      {
+        dir = s->last_dir[k] ? s->last_dir[k] : 1;
+        e->dir[i] = dir;
+        e->px[i] = dir == 1 ? s->dave_px[k] + 18 : s->dave_px[k] - 8;
+        e->py[i] = s->dave_py[k] + 8;
+      }
+    }
+    s->dave_fire[k] = 0;
+  }
+}
+
+static void move_monsters_lanes(struct lockstep *s)
+{
+  const struct monster_track *track;
+  struct entity_pool *e;
+  u32 k;
+  u16 i, step;
+  int j;
+
+  for (k = 0; k < s->count; k++)
+  {
+    e = &s->entities[k];
+    track = &tracks[s->current_level[k]];
+
+    for (i = 0; i < e->count; i++)
+    {
+      if (e->kind[i] != ENTITY_MONSTER || e->dead_timer[i])
+        continue;
+
+      /* Move monster twice each tick */
+      for (j = 0; j < 2; j++)
+      {
+        step = e->path_step[i] + 1;
+        e->px[i] += track->x[step] - track->x[step - 1];
+        e->py[i] += track->y[step] - track->y[step - 1];
+        e->path_step[i] = step == track->loop_end ? track->loop_start : step;
+      }
+
+      e->x[i] = e->px[i] / TILE_SIZE;
+      e->y[i] = e->py[i] / TILE_SIZE;
+    }
+  }
+}
+
+static void fire_monsters_lanes(struct lockstep *s)
+{
+  struct entity_pool *e;
+  struct spatial_grid grid;
+  u16 seen[ENTITY_MAX];
+  u32 k, count, i;
+  int shooter, b;
+
+  for (k = 0; k < s->count; k++)
+  {
+    e = &s->entities[k];
+    if (e->live[ENTITY_EBULLET] >= EBULLET_MAX)
+      continue;
+
+    /* The last visible monster gets the shot */
+    shooter = -1;
+    spatial_build(&grid, e, ENTITY_MONSTER);
+    count = spatial_query(&grid, s->view_x[k], 0, s->view_x[k] + 19, 0xFF, seen);
+    for (i = 0; i < count; i++)
+    {
+      if (!e->dead_timer[seen[i]] && seen[i] > shooter)
+        shooter = seen[i];
+    }
+
+    if (shooter < 0)
+      continue;
+
+    b = entity_spawn(e, ENTITY_EBULLET);
+    if (b < 0)
+      continue;
+
+    e->dir[b] = s->dave_px[k] < e->px[shooter] ? -1 : 1;
+    e->px[b] = e->dir[b] == 1 ? e->px[shooter] + 18 : e->px[shooter] - 8;
+    e->py[b] = e->py[shooter] + 8;
+  }
+}
+
+static void scroll_screen_lanes(struct lockstep *s)
+{
+  u32 k;
+  u8 right, left, cap;
+  int ahead;
+
+  for (k = 0; k < s->count; k++)
+  {
+    ahead = s->dave_x[k] - s->view_x[k];
+    s->scroll_x[k] = ahead >= 18 ? 15 : s->scroll_x[k];
+    s->scroll_x[k] = ahead < 2 ? -15 : s->scroll_x[k];
+
+    /* The right cap snaps the view back to 0, as in scroll_screen */
+    right = s->scroll_x[k] > 0;
+    cap = right && s->view_x[k] == 80;
+    s->view_x[k] = cap ? 0 : s->view_x[k] + right;
+    s->scroll_x[k] -= right && !cap;
+
+    left = s->scroll_x[k] < 0 && s->view_x[k] != 0;
+    s->view_x[k] -= left;
+    s->scroll_x[k] += left;
+  }
+}
+
+static void apply_gravity_lanes(struct lockstep *s)
+{
+  u32 k;
+  u8 not_align;
+
+  for (k = 0; k < s->count; k++)
+  {
+    if (s->dave_jump[k] || s->on_ground[k] || s->dave_jetpack[k] || s->dave_climb[k])
+      continue;
+
+    if (lane_clear(s, k, s->dave_px[k] + 4, s->dave_py[k] + 17, 1))
+      s->dave_py[k] += 2;
+    else
+    {
+      not_align = s->dave_py[k] % TILE_SIZE;
+      if (not_align)
+        s->dave_py[k] = not_align < 8 ? s->dave_py[k] - not_align : s->dave_py[k] + TILE_SIZE - not_align;
+    }
+  }
+}
+
+static void update_level_lanes(struct lockstep *s)
+{
+  struct entity_pool *e;
+  struct spatial_grid grid;
+  u16 hits[ENTITY_MAX];
+  u32 k, count, j;
+  u16 i;
+  u8 fuel;
+
+  for (k = 0; k < s->count; k++)
+  {
+    s->tick[k]++;
+    s->jetpack_delay[k] -= s->jetpack_delay[k] ? 1 : 0;
+
+    fuel = s->dave_jetpack[k] != 0;
+    s->jetpack[k] -= fuel;
+    s->dave_jetpack[k] = fuel && !s->jetpack[k] ? 0 : s->dave_jetpack[k];
+  }
+
+  /* Finished levels and deaths are rare, they take the scalar path */
+  for (k = 0; k < s->count; k++)
+  {
+    if (s->check_door[k])
+    {
+      if (s->trophy[k])
+      {
+        lane_add_score(s, k, 2000);
+        if (s->current_level[k] < 9)
+        {
+          s->current_level[k]++;
+          lane_scalar(s, k, start_level);
+          set_tiles(s, k);
+        }
+        else
+          s->quit[k] = 1;
+      }
+      else
+        s->check_door[k] = 0;
+    }
+
+    if (s->dave_dead_timer[k])
+    {
+      s->dave_dead_timer[k]--;
+      if (!s->dave_dead_timer[k])
+      {
+        if (s->lives[k])
+        {
+          s->lives[k]--;
+          lane_scalar(s, k, restart_level);
+        }
+        else
+          s->quit[k] = 1;
+      }
+    }
+  }
+
+  for (k = 0; k < s->count; k++)
+  {
+    e = &s->entities[k];
+
+    for (i = 0; i < e->count; i++)
+    {
+      if (e->kind[i] == ENTITY_MONSTER && e->dead_timer[i])
+      {
+        e->dead_timer[i]--;
+        if (!e->dead_timer[i])
+          entity_destroy(e, i);
+      }
+    }
+
+    spatial_build(&grid, e, ENTITY_MONSTER);
+    count = spatial_query(&grid, s->dave_x[k], s->dave_y[k], s->dave_x[k], s->dave_y[k], hits);
+    for (j = 0; j < count; j++)
+    {
+      if (!e->dead_timer[hits[j]])
+      {
+        e->dead_timer[hits[j]] = 30;
+        s->dave_dead_timer[k] = 30;
+      }
+    }
+
+    entity_compact(e);
+  }
+}
+
+static void clear_input_lanes(struct lockstep *s)
+{
+  memset(s->try_jump, 0, sizeof(s->try_jump));
+  memset(s->try_right, 0, sizeof(s->try_right));
+  memset(s->try_left, 0, sizeof(s->try_left));
+  memset(s->try_fire, 0, sizeof(s->try_fire));
+  memset(s->try_jetpack, 0, sizeof(s->try_jetpack));
+  memset(s->try_down, 0, sizeof(s->try_down));
+}
+
+/* step_game on every lane, input[k] for lane k. Lanes that have quit
+   keep stepping like a quit game_state would; the caller ignores them */
+void lockstep_step(struct lockstep *s, const u8 *input)
+{
+  apply_input_lanes(s, input);
+  check_collision_lanes(s);
+  pickup_item_lanes(s);
+  update_dbullet_lanes(s);
+  update_ebullet_lanes(s);
+  verify_input_lanes(s);
+  move_dave_lanes(s);
+  move_monsters_lanes(s);
+  fire_monsters_lanes(s);
+  scroll_screen_lanes(s);
+  apply_gravity_lanes(s);
+  update_level_lanes(s);
+  clear_input_lanes(s);
+}
@@ -0,0 +1,79 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "game.h"
+
+#define LOCKSTEP_LANES 32
+
+/* Many game states in structure-of-arrays layout, stepped together
+ * -field[k] is lane k's copy of game_state.field, try_input and
+ *  dave_action are unpacked to a byte per flag
+ * -entities[k] is lane k's entity pool as is
+ * -the current level's tiles, pickups removed, are expanded per lane
+ *  along with their tile_props flags, so load tile props first
+ * -lanes never interact, a tick gives the same result as update_game
+ *  on each lane's game_state
+ */
+struct lockstep
+{
+  u32 count;
+
+  u8 quit[LOCKSTEP_LANES];
+  u8 tick[LOCKSTEP_LANES];
+  u8 dave_tick[LOCKSTEP_LANES];
+  u8 current_level[LOCKSTEP_LANES];
+  u32 score[LOCKSTEP_LANES];
+  u8 lives[LOCKSTEP_LANES];
+  u8 view_x[LOCKSTEP_LANES];
+  u8 view_y[LOCKSTEP_LANES];
+  i8 scroll_x[LOCKSTEP_LANES];
+  i8 dave_x[LOCKSTEP_LANES];
+  i8 dave_y[LOCKSTEP_LANES];
+  i16 dave_px[LOCKSTEP_LANES];
+  i16 dave_py[LOCKSTEP_LANES];
+  u8 on_ground[LOCKSTEP_LANES];
+  i8 last_dir[LOCKSTEP_LANES];
+
+  u8 try_right[LOCKSTEP_LANES];
+  u8 try_left[LOCKSTEP_LANES];
+  u8 try_jump[LOCKSTEP_LANES];
+  u8 try_fire[LOCKSTEP_LANES];
+  u8 try_jetpack[LOCKSTEP_LANES];
+  u8 try_down[LOCKSTEP_LANES];
+  u8 dave_right[LOCKSTEP_LANES];
+  u8 dave_left[LOCKSTEP_LANES];
+  u8 dave_jump[LOCKSTEP_LANES];
+  u8 dave_fire[LOCKSTEP_LANES];
+  u8 dave_jetpack[LOCKSTEP_LANES];
+  u8 dave_climb[LOCKSTEP_LANES];
+  u8 dave_down[LOCKSTEP_LANES];
+  u8 dave_up[LOCKSTEP_LANES];
+  u8 jump_timer[LOCKSTEP_LANES];
+  u8 dave_dead_timer[LOCKSTEP_LANES];
+  u8 jetpack_delay[LOCKSTEP_LANES];
+  u8 check_pickup_x[LOCKSTEP_LANES];
+  u8 check_pickup_y[LOCKSTEP_LANES];
+  u8 check_door[LOCKSTEP_LANES];
+  u8 can_climb[LOCKSTEP_LANES];
+  u8 trophy[LOCKSTEP_LANES];
+  u8 gun[LOCKSTEP_LANES];
+  u8 jetpack[LOCKSTEP_LANES];
+
+  u8 collision_point[9][LOCKSTEP_LANES];
+
+  u8 pickups[LOCKSTEP_LANES][125];
+  u64 pickup_hash[LOCKSTEP_LANES];
+  struct entity_pool entities[LOCKSTEP_LANES];
+  u8 tiles[LOCKSTEP_LANES][1000];
+  u8 flags[LOCKSTEP_LANES][1000]; /* tile_props[tiles].flags */
+
+  /* Rare per-lane events (new level, restart) go through the scalar code */
+  struct game_state scratch;
+};
+
+void lockstep_init(struct lockstep *, const struct game_state *, u32);
+void lockstep_load(struct lockstep *, u32, const struct game_state *);
+void lockstep_store(const struct lockstep *, u32, struct game_state *);
+void lockstep_step(struct lockstep *, const u8 *);
+
+#endif // LOCKSTEP_H
@@ -0,0 +1,200 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include "net.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET net_socket;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+typedef int net_socket;
+#endif
+
+void net_loopback_init(struct net_loopback *link, u32 delay, u32 loss, u32 seed)
+{
+  memset(link->head, 0, sizeof(link->head));
+  memset(link->tail, 0, sizeof(link->tail));
+  link->clock = 0;
+  link->delay = delay;
+  link->loss = loss;
+  link->seed = seed;
+}
+
+/* One tick of link time has gone by */
+void net_loopback_tick(struct net_loopback *link)
+{
+  link->clock++;
+}
+
+void net_loopback_open(struct net_transport *transport, struct net_loopback *link, u8 side)
+{
+  transport->kind = NET_LOOPBACK;
+  transport->link = link;
+  transport->side = side;
+  transport->connected = 1;
+}
+
+/* Listen on port when host is NULL, otherwise send to host:host_port
+   from port. Returns 0 on success */
+int net_udp_open(struct net_transport *transport, u16 port, const char *host, u16 host_port)
+{
+  struct sockaddr_in addr;
+  struct hostent *entry;
+  net_socket fd;
+#ifdef _WIN32
+  WSADATA wsa;
+  u_long nonblocking = 1;
+
+  if (WSAStartup(MAKEWORD(2, 2), &wsa))
+    return 1;
+#endif
+
+  transport->kind = NET_UDP;
+  transport->connected = 0;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+#ifdef _WIN32
+  if (fd == INVALID_SOCKET)
+    return 1;
+  ioctlsocket(fd, FIONBIO, &nonblocking);
+#else
+  if (fd < 0)
+    return 1;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+  transport->socket = (intptr_t)fd;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)))
+  {
+    fprintf(stderr, "Failed to bind UDP port %u\n", port);
+    net_close(transport);
+    return 1;
+  }
+
+  if (!host)
+    return 0;
+
+  addr.sin_addr.s_addr = inet_addr(host);
+  if (addr.sin_addr.s_addr == INADDR_NONE)
+  {
+    entry = gethostbyname(host);
+    if (!entry || entry->h_addrtype != AF_INET)
+    {
+      fprintf(stderr, "Failed to resolve %s\n", host);
+      net_close(transport);
+      return 1;
+    }
+    memcpy(&addr.sin_addr, entry->h_addr_list[0], sizeof(addr.sin_addr));
+  }
+  addr.sin_port = htons(host_port);
+  memcpy(transport->peer, &addr, sizeof(addr));
+  transport->connected = 1;
+
+  return 0;
+}
+
+/* Send one packet, best effort. Returns 0 if it went out */
+int net_send(struct net_transport *transport, const u8 *data, u32 size)
+{
+  struct net_loopback *link = transport->link;
+  struct net_packet *packet;
+  u8 to;
+
+  if (size > NET_PACKET_MAX || !transport->connected)
+    return 1;
+
+  if (transport->kind == NET_UDP)
+    return sendto((net_socket)transport->socket, (const char *)data, size, 0, (const struct sockaddr *)transport->peer, sizeof(struct sockaddr_in)) != (int)size;
+
+  /* Lost on the way, or nowhere to put it */
+  to = !transport->side;
+  link->seed = link->seed * 1664525u + 1013904223u;
+  if ((link->seed >> 8) % 100 < link->loss || link->head[to] - link->tail[to] == NET_LOOPBACK_QUEUE)
+    return 0;
+
+  packet = &link->queue[to][link->head[to]++ & (NET_LOOPBACK_QUEUE - 1)];
+  packet->due = link->clock + link->delay;
+  packet->size = (u8)size;
+  memcpy(packet->data, data, size);
+
+  return 0;
+}
+
+/* Next packet that has arrived, if any. Returns its size, 0 for none */
+u32 net_recv(struct net_transport *transport, u8 *data, u32 size)
+{
+  struct net_loopback *link = transport->link;
+  struct net_packet *packet;
+  struct sockaddr_in from;
+  struct sockaddr_in peer;
+  u8 side = transport->side;
+#ifdef _WIN32
+  int from_size = sizeof(from);
+#else
+  socklen_t from_size = sizeof(from);
+#endif
+  int got;
+
+  if (transport->kind == NET_UDP)
+  {
+    for (;;)
+    {
+      got = recvfrom((net_socket)transport->socket, (char *)data, size, 0, (struct sockaddr *)&from, &from_size);
+      if (got <= 0)
+        return 0;
+
+      /* First packet tells a listening peer where to send */
+      if (!transport->connected)
+      {
+        memcpy(transport->peer, &from, sizeof(from));
+        transport->connected = 1;
+        return (u32)got;
+      }
+
+      /* After that, only the peer gets a say */
+      memcpy(&peer, transport->peer, sizeof(peer));
+      if (from.sin_addr.s_addr == peer.sin_addr.s_addr && from.sin_port == peer.sin_port)
+        return (u32)got;
+      from_size = sizeof(from);
+    }
+  }
+
+  if (link->tail[side] == link->head[side])
+    return 0;
+
+  packet = &link->queue[side][link->tail[side] & (NET_LOOPBACK_QUEUE - 1)];
+  if ((i32)(link->clock - packet->due) < 0)
+    return 0;
+
+  /* Cut short if the caller has less room, as a datagram would be */
+  link->tail[side]++;
+  memcpy(data, packet->data, packet->size < size ? packet->size : size);
+
+  return packet->size < size ? packet->size : size;
+}
+
+void net_close(struct net_transport *transport)
+{
+  if (transport->kind != NET_UDP)
+    return;
+
+#ifdef _WIN32
+  closesocket((net_socket)transport->socket);
+  WSACleanup();
+#else
+  close((net_socket)transport->socket);
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef NET_H
+#define NET_H
+
+#include "game.h"
+
+#define NET_PACKET_MAX 64
+#define NET_LOOPBACK_QUEUE 256    /* Packets in flight each way, a power of two */
+
+/* Transport kinds */
+#define NET_LOOPBACK 1
+#define NET_UDP 2
+
+struct net_packet
+{
+  u32 due;
+  u8 size;
+  u8 data[NET_PACKET_MAX];
+};
+
+/* Two peers in one process, for testing on one machine
+ * -queue[side] holds packets on their way to that side
+ * -clock is in ticks, the driver moves it on with net_loopback_tick
+ * -a packet arrives delay ticks after it was sent, unless it is one
+ *  of the loss in 100 dropped (seeded, so runs repeat)
+ */
+struct net_loopback
+{
+  struct net_packet queue[2][NET_LOOPBACK_QUEUE];
+  u32 head[2];
+  u32 tail[2];
+  u32 clock;
+  u32 delay;
+  u32 loss;
+  u32 seed;
+};
+
+/* One end of a connection. UDP sockets are non-blocking; a peer that
+   listens learns the other's address from its first packet */
+struct net_transport
+{
+  u8 kind;
+
+  /* NET_LOOPBACK */
+  struct net_loopback *link;
+  u8 side;
+
+  /* NET_UDP */
+  intptr_t socket;
+  u8 peer[16];      /* struct sockaddr_in */
+  u8 connected;
+};
+
+void net_loopback_init(struct net_loopback *, u32, u32, u32);
+void net_loopback_tick(struct net_loopback *);
+void net_loopback_open(struct net_transport *, struct net_loopback *, u8);
+int net_udp_open(struct net_transport *, u16, const char *, u16);
+int net_send(struct net_transport *, const u8 *, u32);
+u32 net_recv(struct net_transport *, u8 *, u32);
+void net_close(struct net_transport *);
+
+#endif // NET_H
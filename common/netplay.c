@@ -0,0 +1,263 @@
+#include <string.h>
+#include "netplay.h"
+#include "replay.h"
+
+static void put_u32(u8 *p, u32 value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static u32 get_u32(const u8 *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (u32)p[3] << 24;
+}
+
+/* Both games at the start of a tick still in the window */
+static const struct game_state *games_at(const struct netplay *net, u32 frame)
+{
+  return frame == net->frame ? net->game : net->saved[frame & (NETPLAY_WINDOW - 1)];
+}
+
+static u32 games_checksum(const struct game_state *games)
+{
+  u32 sums[2];
+
+  sums[0] = state_checksum(&games[0]);
+  sums[1] = state_checksum(&games[1]);
+  return fnv1a(FNV_BASIS, sums, sizeof(sums));
+}
+
+/* Save both games, then run them one tick */
+static void step_frame(struct netplay *net)
+{
+  u32 f = net->frame;
+
+  memcpy(net->saved[f & (NETPLAY_WINDOW - 1)], net->game, sizeof(net->game));
+  step_game(&net->game[0], net->input[0][f & (NETPLAY_INPUTS - 1)]);
+  step_game(&net->game[1], net->input[1][f & (NETPLAY_INPUTS - 1)]);
+  net->frame++;
+}
+
+/* Remote input for a tick past confirmed: the last one that came in */
+static u8 predict(const struct netplay *net)
+{
+  u8 remote = !net->local;
+
+  return net->confirmed ? net->input[remote][(net->confirmed - 1) & (NETPLAY_INPUTS - 1)] : 0;
+}
+
+/* Start a match with both players on the same game */
+void netplay_init(struct netplay *net, const struct game_state *start, u8 local, struct net_transport *transport)
+{
+  memcpy(&net->game[0], start, sizeof(struct game_state));
+  memcpy(&net->game[1], start, sizeof(struct game_state));
+  memset(net->input, 0, sizeof(net->input));
+
+  net->transport = transport;
+  net->local = local;
+  net->frame = 0;
+  net->confirmed = 0;
+  net->acked = 0;
+  net->checked = 0;
+  net->remote_check = 0;
+  net->remote_checksum = 0;
+  net->remote_frame = 0;
+  net->remote_ack = 0;
+  net->heard = 0;
+  net->silent = 0;
+  net->ended = NETPLAY_PLAYING;
+  net->rollbacks = 0;
+  net->resimulated = 0;
+  net->stalls = 0;
+  net->desyncs = 0;
+}
+
+/* Take in one packet. Returns the first tick that ran on a wrong
+   prediction, or net->frame if none did */
+static u32 receive(struct netplay *net, const u8 *p, u32 size)
+{
+  u8 remote = !net->local;
+  u32 first, count, ack, check, f, i;
+  u32 rollback = net->frame;
+  u8 *slot;
+
+  if (size == 2 && (p[0] | p[1] << 8) == NETPLAY_QUIT)
+  {
+    net->ended = NETPLAY_REMOTE_QUIT;
+    return rollback;
+  }
+
+  if (size < NETPLAY_HEADER || (p[0] | p[1] << 8) != NETPLAY_MAGIC)
+    return rollback;
+
+  first = get_u32(p + 2);
+  count = p[6];
+  ack = get_u32(p + 7);
+  if (size != NETPLAY_HEADER + count || count > NETPLAY_INPUTS)
+    return rollback;
+
+  /* Inputs have to carry on from the last confirmed one */
+  for (i = 0; i < count; i++)
+  {
+    f = first + i;
+    if (f != net->confirmed)
+      continue;
+
+    slot = &net->input[remote][f & (NETPLAY_INPUTS - 1)];
+    if (f < net->frame && *slot != p[NETPLAY_HEADER + i] && f < rollback)
+      rollback = f;
+    *slot = p[NETPLAY_HEADER + i];
+    net->confirmed++;
+  }
+
+  if (ack > net->acked && ack <= net->frame)
+    net->acked = ack;
+
+  /* Where the remote was when it sent this, for keeping pace */
+  if (first + count > net->remote_frame)
+  {
+    net->remote_frame = first + count;
+    net->remote_ack = ack;
+  }
+
+  /* Compared once any rollback is done */
+  check = get_u32(p + 11);
+  if (check > net->remote_check)
+  {
+    net->remote_check = check;
+    net->remote_checksum = get_u32(p + 15);
+  }
+
+  return rollback;
+}
+
+/* Send every local input the remote has not acknowledged */
+static void send_inputs(struct netplay *net)
+{
+  u8 packet[NETPLAY_HEADER + NETPLAY_INPUTS];
+  u32 count = net->frame - net->acked;
+  u32 check = net->confirmed < net->frame ? net->confirmed : net->frame;
+  u32 i;
+
+  if (count > NETPLAY_INPUTS)
+    count = NETPLAY_INPUTS;
+
+  packet[0] = NETPLAY_MAGIC & 0xFF;
+  packet[1] = NETPLAY_MAGIC >> 8;
+  put_u32(packet + 2, net->acked);
+  packet[6] = (u8)count;
+  put_u32(packet + 7, net->confirmed);
+  put_u32(packet + 11, check);
+  put_u32(packet + 15, games_checksum(games_at(net, check)));
+  for (i = 0; i < count; i++)
+    packet[NETPLAY_HEADER + i] = net->input[net->local][(net->acked + i) & (NETPLAY_INPUTS - 1)];
+
+  net_send(net->transport, packet, NETPLAY_HEADER + count);
+}
+
+/* Take in every packet that has arrived, roll back and run forward again
+   if a prediction was wrong, then tell the remote where this side is.
+   Does nothing once the match has ended */
+void netplay_poll(struct netplay *net)
+{
+  u8 packet[NET_PACKET_MAX];
+  u8 remote = !net->local;
+  u32 rollback = net->frame;
+  u32 target = net->frame;
+  u32 size, f;
+  u8 got = 0;
+
+  if (net->ended)
+    return;
+
+  while ((size = net_recv(net->transport, packet, sizeof(packet))))
+  {
+    f = receive(net, packet, size);
+    if (f < rollback)
+      rollback = f;
+    got = 1;
+  }
+
+  if (got)
+  {
+    net->heard = 1;
+    net->silent = 0;
+  }
+  else if (net->heard && ++net->silent >= NETPLAY_TIMEOUT)
+    net->ended = NETPLAY_TIMED_OUT;
+
+  if (net->ended)
+    return;
+
+  if (rollback < target)
+  {
+    net->rollbacks++;
+    memcpy(net->game, net->saved[rollback & (NETPLAY_WINDOW - 1)], sizeof(net->game));
+    for (net->frame = rollback; net->frame < target; net->resimulated++)
+    {
+      if (net->frame >= net->confirmed)
+        net->input[remote][net->frame & (NETPLAY_INPUTS - 1)] = predict(net);
+      step_frame(net);
+    }
+  }
+
+  /* Compare a tick both sides are done with, once */
+  f = net->remote_check;
+  if (f > net->checked && f <= net->confirmed && f <= net->frame && net->frame - f < NETPLAY_WINDOW)
+  {
+    net->checked = f;
+    if (games_checksum(games_at(net, f)) != net->remote_checksum)
+      net->desyncs++;
+  }
+
+  send_inputs(net);
+}
+
+/* Run one tick with the local player's input. Returns 0 without running
+   it when ahead of the remote, call again with the same input, or once
+   the match has ended */
+int netplay_advance(struct netplay *net, u8 input)
+{
+  u8 remote = !net->local;
+  u32 f = net->frame;
+
+  netplay_poll(net);
+  if (net->ended)
+    return 0;
+
+  /* Each side sees the other about a trip behind. Seeing it further
+     behind than it sees this side means this side is ahead, so wait */
+  if ((i32)(f - net->remote_frame) > (i32)(net->remote_frame - net->remote_ack) + NETPLAY_SLACK)
+  {
+    net->stalls++;
+    return 0;
+  }
+
+  if (f >= net->confirmed + NETPLAY_AHEAD || f - net->acked >= NETPLAY_INPUTS)
+  {
+    net->stalls++;
+    return 0;
+  }
+
+  net->input[net->local][f & (NETPLAY_INPUTS - 1)] = input & INPUT_KEYS;
+  if (f >= net->confirmed)
+    net->input[remote][f & (NETPLAY_INPUTS - 1)] = predict(net);
+  step_frame(net);
+
+  return 1;
+}
+
+/* Tell the remote this side is leaving the match */
+void netplay_quit(struct netplay *net)
+{
+  u8 packet[2];
+  int i;
+
+  packet[0] = NETPLAY_QUIT & 0xFF;
+  packet[1] = NETPLAY_QUIT >> 8;
+  for (i = 0; i < NETPLAY_QUIT_SENDS; i++)
+    net_send(net->transport, packet, sizeof(packet));
+}
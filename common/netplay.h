@@ -0,0 +1,74 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include "game.h"
+#include "net.h"
+
+#define NETPLAY_MAGIC 0x4E44    /* "DN" little-endian */
+#define NETPLAY_QUIT 0x5144     /* "DQ", the whole of a quit packet */
+#define NETPLAY_WINDOW 16       /* Saved ticks, a power of two */
+#define NETPLAY_INPUTS 32       /* Input history, a power of two */
+#define NETPLAY_AHEAD 12        /* Most ticks run on predicted input */
+#define NETPLAY_SLACK 2         /* Lead over the remote allowed before waiting */
+#define NETPLAY_HEADER 19
+#define NETPLAY_TIMEOUT 150     /* Polls without a packet before giving up, 5 s */
+#define NETPLAY_QUIT_SENDS 3    /* Copies of the quit packet, any may be lost */
+
+/* Why a match ended */
+#define NETPLAY_PLAYING 0
+#define NETPLAY_REMOTE_QUIT 1   /* The remote sent a quit packet */
+#define NETPLAY_TIMED_OUT 2     /* Nothing came for NETPLAY_TIMEOUT polls */
+
+/* Two-player versus over rollback netcode. Each player runs their own
+   game of the same levels, both peers simulate both games
+ * -every tick saves both games, then steps them with the local input
+ *  and the remote one, predicted as the last one received when it has
+ *  not arrived yet
+ * -when a remote input turns out different from the prediction, the
+ *  games are restored to that tick and run forward again
+ * -packets carry every input the other side has not acknowledged, so
+ *  lost ones are made up by the next, plus the checksum of the newest
+ *  tick both sides agree on to catch desyncs
+ * A peer that gets ahead of the other waits a tick now and then so both
+ * predict about as often. Running more than NETPLAY_AHEAD ticks past
+ * the remote input stalls until it catches up.
+ *
+ * A peer that closes, or whose game ends, sends a quit packet. A peer
+ * that hears neither that nor anything else for NETPLAY_TIMEOUT polls,
+ * once it has heard from the remote at all, ends the match too.
+ *
+ * Packet: magic u16, first frame u32, input count u8, ack u32, checked
+ * frame u32, checksum u32, inputs. All values little-endian.
+ */
+struct netplay
+{
+  struct game_state game[2];
+  struct game_state saved[NETPLAY_WINDOW][2];   /* Both games at the start of a tick */
+  u8 input[2][NETPLAY_INPUTS];                  /* Remote ones predicted past confirmed */
+
+  struct net_transport *transport;
+  u8 local;           /* Player this peer controls */
+  u32 frame;          /* Next tick to simulate */
+  u32 confirmed;      /* Remote input is known below this tick */
+  u32 acked;          /* The remote has local input below this tick */
+  u32 checked;        /* Newest tick whose checksum was compared */
+  u32 remote_check;   /* Newest tick the remote sent a checksum for */
+  u32 remote_checksum;
+  u32 remote_frame;   /* Newest tick the remote had reached */
+  u32 remote_ack;     /* Local input it had at the time */
+  u8 heard;           /* A packet has come from the remote */
+  u32 silent;         /* Polls since the last one */
+  u8 ended;           /* NETPLAY_PLAYING, or why the match ended */
+
+  u32 rollbacks;
+  u32 resimulated;
+  u32 stalls;
+  u32 desyncs;
+};
+
+void netplay_init(struct netplay *, const struct game_state *, u8, struct net_transport *);
+void netplay_poll(struct netplay *);
+int netplay_advance(struct netplay *, u8);
+void netplay_quit(struct netplay *);
+
+#endif // NETPLAY_H
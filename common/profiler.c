@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <string.h>
+#include "profiler.h"
+#include "trace.h"
+
+u8 profiler_enabled = 0;
+u8 profiler_overlay = 0;
+u8 profiler_flash = 0;
+u32 profiler_frames = 0;
+
+static struct profile_histogram histograms[PROF_COUNT];
+static double ns_per_count;
+static u64 startup_marks[STARTUP_COUNT];
+
+/* Printed by startup_print. Order must match enum startup_phase */
+static const char *startup_names[STARTUP_COUNT] = {
+    "begin",
+    "init_game",
+    "init_assets",
+    "init_sdl",
+    "start_level",
+    "first_frame"};
+
+/* Names written to the JSON report. Order must match enum profile_zone */
+static const char *profiler_names[PROF_COUNT] = {
+    "init_game",
+    "load_level",
+    "init_assets",
+    "load_tile",
+    "first_frame",
+    "tick",
+    "frame",
+    "check_input",
+    "input_delay",
+    "present_delay",
+    "input_latency",
+    "update_game",
+    "check_collision",
+    "pickup_item",
+    "update_dbullet",
+    "update_ebullet",
+    "verify_input",
+    "move_dave",
+    "move_monsters",
+    "fire_monsters",
+    "scroll_screen",
+    "apply_gravity",
+    "update_level",
+    "clear_input",
+    "render",
+    "draw_world",
+    "draw_dave",
+    "draw_monsters",
+    "draw_dave_bullet",
+    "draw_monster_bullet",
+    "draw_ui",
+    "render_present"};
+
+/* Bucket index of a duration. Small values map one-to-one, larger ones
+   keep the top PROF_SUB_BITS bits below the leading one */
+static u32 bucket_of(u32 ns)
+{
+  u32 msb = 0;
+
+  if (ns < (1u << PROF_SUB_BITS))
+    return ns;
+
+  while (ns >> (msb + 1))
+    msb++;
+
+  return ((msb - PROF_SUB_BITS + 1) << PROF_SUB_BITS) + ((ns >> (msb - PROF_SUB_BITS)) & ((1u << PROF_SUB_BITS) - 1));
+}
+
+/* Middle of the range a bucket covers */
+static u32 bucket_value(u32 bucket)
+{
+  u32 shift, base;
+
+  if (bucket < (1u << PROF_SUB_BITS))
+    return bucket;
+
+  shift = (bucket >> PROF_SUB_BITS) - 1;
+  base = ((1u << PROF_SUB_BITS) | (bucket & ((1u << PROF_SUB_BITS) - 1))) << shift;
+
+  return base + (shift ? (1u << shift) / 2 : 0);
+}
+
+void profiler_init(void)
+{
+  memset(histograms, 0, sizeof(histograms));
+  ns_per_count = 1000000000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+/* F3 shows the overlay and starts timing if it wasn't already */
+void profiler_toggle_overlay(void)
+{
+  profiler_overlay = !profiler_overlay;
+  if (profiler_overlay)
+    profiler_enabled |= PROFILE_TIMERS;
+}
+
+/* Add the time since begin to a zone and/or the trace. Lock-free, safe from any thread */
+void profiler_record(enum profile_zone zone, u64 begin)
+{
+  struct profile_histogram *h = &histograms[zone];
+  u64 end = SDL_GetPerformanceCounter();
+  double elapsed = (double)(end - begin) * ns_per_count;
+  u32 ns = elapsed > 2147483647.0 ? 2147483647u : (u32)elapsed;
+  int old;
+
+  if (profiler_enabled & PROFILE_TRACE)
+    trace_record(profiler_names[zone], begin, end);
+
+  if (!(profiler_enabled & PROFILE_TIMERS))
+    return;
+
+  SDL_AtomicAdd(&h->bucket[bucket_of(ns)], 1);
+  SDL_AtomicAdd(&h->count, 1);
+
+  do
+    old = SDL_AtomicGet(&h->max);
+  while ((u32)old < ns && !SDL_AtomicCAS(&h->max, old, (int)ns));
+
+  SDL_AtomicSet(&h->history[SDL_AtomicAdd(&h->history_index, 1) & (PROF_HISTORY - 1)], (int)ns);
+}
+
+/* Approximate duration in ns below which permille of the samples fall */
+u32 profiler_percentile(enum profile_zone zone, u32 permille)
+{
+  struct profile_histogram *h = &histograms[zone];
+  u32 count = (u32)SDL_AtomicGet(&h->count);
+  u32 target = (u32)(((u64)count * permille + 999) / 1000);
+  u32 max = (u32)SDL_AtomicGet(&h->max);
+  u32 seen = 0;
+  u32 i;
+
+  if (!count)
+    return 0;
+
+  /* Bucket midpoints can overshoot the largest sample */
+  for (i = 0; i < PROF_BUCKETS; i++)
+  {
+    seen += (u32)SDL_AtomicGet(&h->bucket[i]);
+    if (seen >= target)
+      return bucket_value(i) < max ? bucket_value(i) : max;
+  }
+
+  return max;
+}
+
+/* A startup phase has ended. Only the first mark of each counts */
+void startup_mark(enum startup_phase phase)
+{
+  if (!startup_marks[phase])
+    startup_marks[phase] = SDL_GetPerformanceCounter();
+}
+
+/* One line with the milliseconds each startup phase took, for the
+   startup.sh driver to collect */
+void startup_print(void)
+{
+  double ms_per_count = 1000.0 / (double)SDL_GetPerformanceFrequency();
+  int i;
+
+  printf("Startup:");
+  for (i = STARTUP_BEGIN + 1; i < STARTUP_COUNT; i++)
+    printf(" %s %.3f ms,", startup_names[i], (startup_marks[i] - startup_marks[i - 1]) * ms_per_count);
+  printf(" total %.3f ms\n", (startup_marks[STARTUP_COUNT - 1] - startup_marks[STARTUP_BEGIN]) * ms_per_count);
+}
+
+/* Write p50/p99/max per zone as JSON. Returns 0 on success */
+int profiler_dump(const char *fname)
+{
+  FILE *fout;
+  int i;
+
+  fout = fopen(fname, "w");
+  if (!fout)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  fprintf(fout, "{\n  \"unit\": \"us\",\n  \"zones\": [\n");
+  for (i = 0; i < PROF_COUNT; i++)
+  {
+    fprintf(fout, "    {\"name\": \"%s\", \"count\": %d, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}%s\n",
+            profiler_names[i],
+            SDL_AtomicGet(&histograms[i].count),
+            profiler_percentile((enum profile_zone)i, 500) / 1000.0,
+            profiler_percentile((enum profile_zone)i, 990) / 1000.0,
+            (u32)SDL_AtomicGet(&histograms[i].max) / 1000.0,
+            i + 1 < PROF_COUNT ? "," : "");
+  }
+  fprintf(fout, "  ]\n}\n");
+
+  fclose(fout);
+  return 0;
+}
+
+/* Bar graph of the last PROF_HISTORY frames in the top right corner.
+   Green is the whole render, yellow the simulation tick. 2 pixels per
+   millisecond, so the top of the box is the 33 ms frame budget */
+void draw_profiler(SDL_Renderer *renderer)
+{
+  SDL_Rect dest;
+  int newest, i, h;
+
+  dest.x = 320 - PROF_HISTORY * 2;
+  dest.y = 18;
+  dest.w = PROF_HISTORY * 2;
+  dest.h = 66;
+  SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
+  SDL_RenderFillRect(renderer, &dest);
+
+  dest.w = 2;
+  for (i = 0; i < PROF_HISTORY; i++)
+  {
+    dest.x = 320 - PROF_HISTORY * 2 + i * 2;
+
+    newest = SDL_AtomicGet(&histograms[PROF_RENDER].history_index);
+    h = SDL_AtomicGet(&histograms[PROF_RENDER].history[(newest + i) & (PROF_HISTORY - 1)]) / 500000;
+    dest.h = h > 66 ? 66 : h;
+    dest.y = 84 - dest.h;
+    SDL_SetRenderDrawColor(renderer, 0x00, 0xEE, 0x00, 0xFF);
+    SDL_RenderFillRect(renderer, &dest);
+
+    newest = SDL_AtomicGet(&histograms[PROF_UPDATE_GAME].history_index);
+    h = SDL_AtomicGet(&histograms[PROF_UPDATE_GAME].history[(newest + i) & (PROF_HISTORY - 1)]) / 500000;
+    dest.h = h > 66 ? 66 : h;
+    dest.y = 84 - dest.h;
+    SDL_SetRenderDrawColor(renderer, 0xEE, 0xEE, 0x00, 0xFF);
+    SDL_RenderFillRect(renderer, &dest);
+  }
+}
+
+/* White square in the top left corner on the first frame that shows a
+   key press, for checking the latency figures with a camera */
+void draw_latency_flash(SDL_Renderer *renderer)
+{
+  SDL_Rect dest;
+
+  dest.x = 0;
+  dest.y = 0;
+  dest.w = 16;
+  dest.h = 16;
+  SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+  SDL_RenderFillRect(renderer, &dest);
+}
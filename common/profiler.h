@@ -0,0 +1,109 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <SDL.h>
+#include "variables.h"
+
+/* Timed sections of the game loop. Order must match profiler_names */
+enum profile_zone
+{
+  PROF_INIT_GAME,
+  PROF_LOAD_LEVEL,
+  PROF_INIT_ASSETS,
+  PROF_LOAD_TILE,
+  PROF_FIRST_FRAME,
+  PROF_TICK,
+  PROF_FRAME,
+  PROF_CHECK_INPUT,
+  PROF_INPUT_DELAY,
+  PROF_PRESENT_DELAY,
+  PROF_INPUT_LATENCY,
+  PROF_UPDATE_GAME,
+  PROF_CHECK_COLLISION,
+  PROF_PICKUP_ITEM,
+  PROF_UPDATE_DBULLET,
+  PROF_UPDATE_EBULLET,
+  PROF_VERIFY_INPUT,
+  PROF_MOVE_DAVE,
+  PROF_MOVE_MONSTERS,
+  PROF_FIRE_MONSTERS,
+  PROF_SCROLL_SCREEN,
+  PROF_APPLY_GRAVITY,
+  PROF_UPDATE_LEVEL,
+  PROF_CLEAR_INPUT,
+  PROF_RENDER,
+  PROF_DRAW_WORLD,
+  PROF_DRAW_DAVE,
+  PROF_DRAW_MONSTERS,
+  PROF_DRAW_DAVE_BULLET,
+  PROF_DRAW_MONSTER_BULLET,
+  PROF_DRAW_UI,
+  PROF_RENDER_PRESENT,
+  PROF_COUNT
+};
+
+/* Ends of the startup phases, see startup_mark. Order must match
+   startup_names */
+enum startup_phase
+{
+  STARTUP_BEGIN,
+  STARTUP_INIT_GAME,
+  STARTUP_INIT_ASSETS,
+  STARTUP_INIT_SDL,
+  STARTUP_START_LEVEL,
+  STARTUP_FIRST_FRAME,
+  STARTUP_COUNT
+};
+
+/* Bits of profiler_enabled */
+#define PROFILE_TIMERS 0x1
+#define PROFILE_TRACE 0x2
+
+/* Log-linear buckets: 8 per power of two, nanosecond resolution */
+#define PROF_SUB_BITS 3
+#define PROF_BUCKETS 256
+#define PROF_HISTORY 64
+
+/* Lock-free histogram. Any thread may record into any zone */
+struct profile_histogram
+{
+  SDL_atomic_t bucket[PROF_BUCKETS];
+  SDL_atomic_t count;
+  SDL_atomic_t max;
+  SDL_atomic_t history[PROF_HISTORY];
+  SDL_atomic_t history_index;
+};
+
+/* Checked before every timer. Written by the render thread only;
+   a stale read just starts or stops timing a tick late */
+extern u8 profiler_enabled;
+extern u8 profiler_overlay;
+extern u8 profiler_flash;
+
+/* Frames the game loop presents before it quits, 0 to play on */
+extern u32 profiler_frames;
+
+/* Start of a timed section, or 0 when nothing is being recorded */
+#define PROFILE_NOW() (profiler_enabled ? SDL_GetPerformanceCounter() : 0)
+
+/* Time a single statement. Costs one load and branch when disabled */
+#define PROFILE(zone, call)                   \
+  do                                          \
+  {                                           \
+    u64 profile_begin_ = PROFILE_NOW();       \
+    call;                                     \
+    if (profile_begin_)                       \
+      profiler_record(zone, profile_begin_);  \
+  } while (0)
+
+void profiler_init(void);
+void profiler_toggle_overlay(void);
+void profiler_record(enum profile_zone, u64);
+u32 profiler_percentile(enum profile_zone, u32);
+int profiler_dump(const char *);
+void startup_mark(enum startup_phase);
+void startup_print(void);
+void draw_profiler(SDL_Renderer *);
+void draw_latency_flash(SDL_Renderer *);
+
+#endif // PROFILER_H
@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+#include "statehash.h"
+#include "levelcache.h"
+
+/* 32-bit FNV-1a, start from FNV_BASIS */
+u32 fnv1a(u32 hash, const void *data, size_t size)
+{
+  const u8 *p = (const u8 *)data;
+
+  while (size--)
+  {
+    hash ^= *p++;
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+/* Identifies the level set a replay was recorded against */
+u32 level_hash(void)
+{
+  levels_require_all();
+  return fnv1a(FNV_BASIS, levels, sizeof(levels));
+}
+
+/* Everything that changes during play, pickups included. state_hash
+   folded to 32 bits */
+u32 state_checksum(const struct game_state *game)
+{
+  u64 hash = state_hash(game);
+
+  return (u32)(hash ^ hash >> 32);
+}
+
+/* Start recording a game that has just been through start_level */
+void replay_record(struct replay *replay, const struct game_state *game)
+{
+  memset(replay, 0, sizeof(struct replay));
+  replay->mode = REPLAY_RECORD;
+  replay->level_hash = level_hash();
+  replay->start_level = game->current_level;
+  replay->interval = REPLAY_INTERVAL;
+}
+
+/* Put a game in the replay's start state. Returns 1 if the level data
+   differs from what was recorded, playback would desync */
+int replay_start(struct replay *replay, struct game_state *game)
+{
+  if (level_hash() != replay->level_hash)
+  {
+    fprintf(stderr, "Replay was recorded with different level data\n");
+    return 1;
+  }
+
+  game->current_level = replay->start_level;
+  start_level(game);
+
+  replay->tick = 0;
+  replay->run = 0;
+  replay->run_tick = 0;
+  replay->mismatches = 0;
+
+  return 0;
+}
+
+static void *grow(void *data, u32 *capacity, size_t size)
+{
+  *capacity = *capacity ? *capacity * 2 : 256;
+  return realloc(data, *capacity * size);
+}
+
+static void add_input(struct replay *replay, u8 input)
+{
+  struct replay_run *last = replay->run_count ? &replay->runs[replay->run_count - 1] : NULL;
+
+  if (last && last->input == input && last->length < 0xFFFF)
+  {
+    last->length++;
+    return;
+  }
+
+  if (replay->run_count == replay->run_capacity)
+    replay->runs = (struct replay_run *)grow(replay->runs, &replay->run_capacity, sizeof(struct replay_run));
+
+  replay->runs[replay->run_count].input = input;
+  replay->runs[replay->run_count].length = 1;
+  replay->run_count++;
+}
+
+/* Input of the next tick in playback, 0 once the replay has run out */
+static u8 next_input(struct replay *replay)
+{
+  u8 input;
+
+  if (replay->run >= replay->run_count)
+    return 0;
+
+  input = replay->runs[replay->run].input;
+  if (++replay->run_tick == replay->runs[replay->run].length)
+  {
+    replay->run++;
+    replay->run_tick = 0;
+  }
+
+  return input;
+}
+
+/* Step the game one tick. Records the input, or replaces it with the
+   recorded one and checks the state against the recording. Playback
+   sets quit when the replay ends */
+void replay_step(struct replay *replay, struct game_state *game, u8 input)
+{
+  u32 checksum;
+
+  if (replay->mode == REPLAY_PLAY)
+    input = next_input(replay);
+
+  step_game(game, input);
+  replay->tick++;
+
+  if (replay->mode == REPLAY_RECORD)
+  {
+    add_input(replay, input);
+    replay->ticks = replay->tick;
+
+    if (replay->tick % replay->interval == 0)
+    {
+      if (replay->checksum_count == replay->checksum_capacity)
+        replay->checksums = (u32 *)grow(replay->checksums, &replay->checksum_capacity, sizeof(u32));
+      replay->checksums[replay->checksum_count++] = state_checksum(game);
+    }
+    return;
+  }
+
+  if (replay->tick % replay->interval == 0 && replay->tick / replay->interval <= replay->checksum_count)
+  {
+    checksum = state_checksum(game);
+    if (checksum != replay->checksums[replay->tick / replay->interval - 1])
+    {
+      if (!replay->mismatches)
+        fprintf(stderr, "Replay desync at tick %u\n", replay->tick);
+      replay->mismatches++;
+    }
+  }
+
+  if (replay->tick >= replay->ticks)
+    game->quit = 1;
+}
+
+static void put_u32(u8 *p, u32 value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static u32 get_u32(const u8 *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (u32)p[3] << 24;
+}
+
+/* Returns 0 on success */
+int replay_save(const struct replay *replay, const char *fname)
+{
+  FILE *fout;
+  u8 header[32];
+  u8 run[3];
+  u8 checksum[4];
+  u32 i;
+
+  fout = fopen(fname, "wb");
+  if (!fout)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  put_u32(&header[0], REPLAY_MAGIC);
+  put_u32(&header[4], REPLAY_VERSION);
+  put_u32(&header[8], replay->level_hash);
+  put_u32(&header[12], replay->start_level);
+  put_u32(&header[16], replay->ticks);
+  put_u32(&header[20], replay->interval);
+  put_u32(&header[24], replay->run_count);
+  put_u32(&header[28], replay->checksum_count);
+  fwrite(header, sizeof(header), 1, fout);
+
+  for (i = 0; i < replay->run_count; i++)
+  {
+    run[0] = replay->runs[i].input;
+    run[1] = replay->runs[i].length & 0xFF;
+    run[2] = replay->runs[i].length >> 8;
+    fwrite(run, sizeof(run), 1, fout);
+  }
+
+  for (i = 0; i < replay->checksum_count; i++)
+  {
+    put_u32(checksum, replay->checksums[i]);
+    fwrite(checksum, sizeof(checksum), 1, fout);
+  }
+
+  fclose(fout);
+  return 0;
+}
+
+/* Read a replay for playback. Returns 0 on success */
+int replay_load(struct replay *replay, const char *fname)
+{
+  FILE *fin;
+  u8 header[32];
+  u8 run[3];
+  u8 checksum[4];
+  long size;
+  u32 i, j;
+
+  memset(replay, 0, sizeof(struct replay));
+
+  fin = fopen(fname, "rb");
+  if (!fin)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  fseek(fin, 0, SEEK_END);
+  size = ftell(fin);
+  fseek(fin, 0, SEEK_SET);
+
+  if (fread(header, sizeof(header), 1, fin) != 1 || get_u32(&header[0]) != REPLAY_MAGIC || get_u32(&header[4]) != REPLAY_VERSION)
+  {
+    fprintf(stderr, "%s is not a replay file\n", fname);
+    fclose(fin);
+    return 1;
+  }
+
+  replay->mode = REPLAY_PLAY;
+  replay->level_hash = get_u32(&header[8]);
+  replay->start_level = (u8)get_u32(&header[12]);
+  replay->ticks = get_u32(&header[16]);
+  replay->interval = get_u32(&header[20]);
+  replay->run_count = replay->run_capacity = get_u32(&header[24]);
+  replay->checksum_count = replay->checksum_capacity = get_u32(&header[28]);
+
+  /* The counts come from the file, they have to fit in what is left of
+     it before anything is allocated for them */
+  if (get_u32(&header[12]) > 9 || size < (long)sizeof(header) ||
+      (u64)replay->run_count * sizeof(run) + (u64)replay->checksum_count * sizeof(checksum) > (u64)size - sizeof(header))
+  {
+    fprintf(stderr, "%s is corrupt\n", fname);
+    fclose(fin);
+    return 1;
+  }
+
+  replay->runs = (struct replay_run *)malloc(replay->run_count * sizeof(struct replay_run) + 1);
+  replay->checksums = (u32 *)malloc(replay->checksum_count * sizeof(u32) + 1);
+  if (!replay->runs || !replay->checksums)
+  {
+    fprintf(stderr, "Out of memory reading %s\n", fname);
+    fclose(fin);
+    replay_free(replay);
+    return 1;
+  }
+
+  for (j = 0; j < replay->run_count && fread(run, sizeof(run), 1, fin) == 1; j++)
+  {
+    replay->runs[j].input = run[0];
+    replay->runs[j].length = run[1] | run[2] << 8;
+  }
+
+  for (i = 0; i < replay->checksum_count && fread(checksum, sizeof(checksum), 1, fin) == 1; i++)
+    replay->checksums[i] = get_u32(checksum);
+
+  fclose(fin);
+
+  if (!replay->interval || j < replay->run_count || i < replay->checksum_count)
+  {
+    fprintf(stderr, "%s is truncated\n", fname);
+    replay_free(replay);
+    return 1;
+  }
+
+  return 0;
+}
+
+void replay_free(struct replay *replay)
+{
+  free(replay->runs);
+  free(replay->checksums);
+  replay->runs = NULL;
+  replay->checksums = NULL;
+}
@@ -0,0 +1,62 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "game.h"
+
+#define REPLAY_MAGIC 0x50524444 /* "DDRP" little-endian */
+#define REPLAY_VERSION 6
+#define REPLAY_INTERVAL 150     /* Ticks between state checksums */
+
+#define REPLAY_RECORD 1
+#define REPLAY_PLAY 2
+
+#define FNV_BASIS 2166136261u
+
+/* One run of identical input */
+struct replay_run
+{
+  u8 input;
+  u16 length;
+};
+
+/* Replay file contents
+ * -header: magic, version, level hash, start level, tick count,
+ *  checksum interval, run count, checksum count
+ * -runs: input byte + 16-bit length each
+ * -checksums: state checksum after every interval ticks
+ * All values little-endian
+ */
+struct replay
+{
+  u8 mode;
+  u32 level_hash;
+  u8 start_level;
+  u32 ticks;
+  u32 interval;
+
+  struct replay_run *runs;
+  u32 run_count;
+  u32 run_capacity;
+  u32 *checksums;
+  u32 checksum_count;
+  u32 checksum_capacity;
+
+  /* Playback cursor */
+  u32 tick;
+  u32 run;
+  u16 run_tick;
+  u32 mismatches;
+};
+
+u32 fnv1a(u32, const void *, size_t);
+u32 level_hash(void);
+u32 state_checksum(const struct game_state *);
+
+void replay_record(struct replay *, const struct game_state *);
+int replay_load(struct replay *, const char *);
+int replay_start(struct replay *, struct game_state *);
+void replay_step(struct replay *, struct game_state *, u8);
+int replay_save(const struct replay *, const char *);
+void replay_free(struct replay *);
+
+#endif // REPLAY_H
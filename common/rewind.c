@@ -0,0 +1,182 @@
+#include <string.h>
+#include "rewind.h"
+
+#define RING_MASK (REWIND_BYTES - 1)
+#define KEYFRAME 0x8000
+
+/* Keyframes are encoded as a delta from this */
+static const u8 zero_frame[REWIND_FRAME] = {0};
+
+/* Copy in and out of the ring, wrapping at the end */
+static void ring_write(struct rewind_buffer *buffer, u32 pos, const u8 *data, u32 size)
+{
+  u32 first = REWIND_BYTES - (pos & RING_MASK);
+
+  if (first > size)
+    first = size;
+  memcpy(&buffer->ring[pos & RING_MASK], data, first);
+  memcpy(buffer->ring, data + first, size - first);
+}
+
+static void ring_read(const struct rewind_buffer *buffer, u32 pos, u8 *data, u32 size)
+{
+  u32 first = REWIND_BYTES - (pos & RING_MASK);
+
+  if (first > size)
+    first = size;
+  memcpy(data, &buffer->ring[pos & RING_MASK], first);
+  memcpy(data + first, buffer->ring, size - first);
+}
+
+static u16 ring_u16(const struct rewind_buffer *buffer, u32 pos)
+{
+  return buffer->ring[pos & RING_MASK] | buffer->ring[(pos + 1) & RING_MASK] << 8;
+}
+
+/* XOR of two frames as zero runs and literal runs. Gives up and returns
+   0 once the encoding gets as big as a keyframe */
+static u32 encode(u8 *out, const u8 *a, const u8 *b)
+{
+  u32 size = 0;
+  u32 i = 0;
+  u32 n;
+
+  while (i < REWIND_FRAME)
+  {
+    for (n = 0; n < 128 && i + n < REWIND_FRAME && a[i + n] == b[i + n]; n++)
+      ;
+    if (n)
+    {
+      out[size++] = (u8)(n - 1);
+      i += n;
+      continue;
+    }
+
+    for (n = 0; n < 128 && i + n < REWIND_FRAME && a[i + n] != b[i + n]; n++)
+      out[size + 1 + n] = a[i + n] ^ b[i + n];
+    out[size] = (u8)(0x80 | (n - 1));
+    size += n + 1;
+    i += n;
+
+    if (size >= REWIND_FRAME)
+      return 0;
+  }
+
+  return size;
+}
+
+static void decode(u8 *frame, const u8 *in, u32 size)
+{
+  u32 i = 0;
+  u32 p = 0;
+  u32 n;
+
+  while (p < size)
+  {
+    n = (in[p] & 0x7F) + 1;
+    if (in[p++] & 0x80)
+    {
+      while (n--)
+        frame[i++] ^= in[p++];
+    }
+    else
+      i += n;
+  }
+}
+
+/* Start an empty history at the game's current state */
+void rewind_init(struct rewind_buffer *buffer, const struct game_state *game)
+{
+  buffer->head = 0;
+  buffer->tail = 0;
+  buffer->used = 0;
+  buffer->count = 0;
+  buffer->since_keyframe = 0;
+  memcpy(buffer->frame, game, REWIND_FRAME);
+}
+
+/* Call after every tick, records how to get back to the previous one */
+void rewind_push(struct rewind_buffer *buffer, const struct game_state *game)
+{
+  const u8 *payload = buffer->scratch;
+  u32 size = 0;
+  u16 tag;
+  u16 oldest;
+  u8 framing[2];
+
+  memcpy(buffer->next, game, REWIND_FRAME);
+
+  if (buffer->since_keyframe)
+    size = encode(buffer->scratch, buffer->next, buffer->frame);
+  if (size)
+    tag = (u16)size;
+  else
+  {
+    /* Most of the entity pool is zero, keyframes encode well too */
+    size = encode(buffer->scratch, buffer->frame, zero_frame);
+    if (!size)
+    {
+      payload = buffer->frame;
+      size = REWIND_FRAME;
+    }
+    tag = (u16)(size | KEYFRAME);
+  }
+  buffer->since_keyframe = (buffer->since_keyframe + 1) % REWIND_KEYFRAME;
+
+  /* Drop the oldest records until this one fits */
+  while (buffer->count && (buffer->count == REWIND_TICKS || buffer->used + size + 4 > REWIND_BYTES))
+  {
+    oldest = ring_u16(buffer, buffer->tail) & ~KEYFRAME;
+    buffer->tail += oldest + 4;
+    buffer->used -= oldest + 4;
+    buffer->count--;
+  }
+
+  framing[0] = tag & 0xFF;
+  framing[1] = tag >> 8;
+  ring_write(buffer, buffer->head, framing, 2);
+  ring_write(buffer, buffer->head + 2, payload, size);
+  ring_write(buffer, buffer->head + 2 + size, framing, 2);
+  buffer->head += size + 4;
+  buffer->used += size + 4;
+  buffer->count++;
+
+  memcpy(buffer->frame, buffer->next, REWIND_FRAME);
+}
+
+/* Take the game one tick back. quit is left alone so a rewind never
+   undoes a request to exit. Returns 0 once the history runs out */
+int rewind_pop(struct rewind_buffer *buffer, struct game_state *game)
+{
+  u32 size;
+  u16 tag;
+  u8 quit = game->quit;
+
+  if (!buffer->count)
+    return 0;
+
+  tag = ring_u16(buffer, buffer->head - 2);
+  size = tag & ~KEYFRAME;
+  buffer->head -= size + 4;
+  buffer->used -= size + 4;
+  buffer->count--;
+
+  if ((tag & KEYFRAME) && size == REWIND_FRAME)
+    ring_read(buffer, buffer->head + 2, buffer->frame, size);
+  else if (tag & KEYFRAME)
+  {
+    memset(buffer->frame, 0, REWIND_FRAME);
+    ring_read(buffer, buffer->head + 2, buffer->scratch, size);
+    decode(buffer->frame, buffer->scratch, size);
+  }
+  else
+  {
+    ring_read(buffer, buffer->head + 2, buffer->scratch, size);
+    decode(buffer->frame, buffer->scratch, size);
+  }
+
+  memcpy(game, buffer->frame, REWIND_FRAME);
+  game->quit = quit;
+
+  return 1;
+}
@@ -0,0 +1,42 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "game.h"
+
+#define REWIND_TICKS 900           /* 30 seconds at 30 ticks per second */
+#define REWIND_KEYFRAME 30         /* Ticks between full frames */
+#define REWIND_BYTES (1 << 17)     /* Ring size, a power of two */
+
+/* A game_state holds only mutable data, frames are whole states */
+#define REWIND_FRAME sizeof(struct game_state)
+
+/* Ring of records, newest at head, each one takes the game a tick back
+ * -delta: previous frame XOR this one, run-length encoded (zero runs
+ *  and literal runs of up to 128 bytes behind a control byte)
+ * -keyframe: the previous frame, every REWIND_KEYFRAME ticks and
+ *  whenever a delta would not be smaller. Encoded the same way as a
+ *  delta from an all-zero frame, or as is when that is no smaller
+ * Records are framed by their u16 size at both ends, the top bit marks
+ * a keyframe, so the ring can be walked from either end. Oldest records
+ * are dropped to stay within REWIND_TICKS and REWIND_BYTES.
+ * Everything is preallocated, pushing and popping never allocate.
+ */
+struct rewind_buffer
+{
+  u8 ring[REWIND_BYTES];
+  u32 head;
+  u32 tail;
+  u32 used;
+  u32 count;
+  u32 since_keyframe;
+
+  u8 frame[REWIND_FRAME];         /* Last pushed state */
+  u8 next[REWIND_FRAME];
+  u8 scratch[REWIND_FRAME + 129]; /* Encoded delta, may overshoot by one run */
+};
+
+void rewind_init(struct rewind_buffer *, const struct game_state *);
+void rewind_push(struct rewind_buffer *, const struct game_state *);
+int rewind_pop(struct rewind_buffer *, struct game_state *);
+
+#endif // REWIND_H
@@ -0,0 +1,418 @@
+#include <stdlib.h>
+#include <string.h>
+#include "route.h"
+#include "statehash.h"
+#include "tileset.h"
+#include "workpool.h"
+
+#define ROUTE_FAR 0xFFFF
+#define ROUTE_CELLS 2001
+#ifndef ROUTE_PATIENCE
+#define ROUTE_PATIENCE 16
+#endif
+
+/* Child status */
+#define ROUTE_DEAD 0
+#define ROUTE_OPEN 1
+#define ROUTE_DONE 2    /* Finished the level */
+
+static const u8 actions[ROUTE_ACTIONS] =
+{
+  0, INPUT_RIGHT, INPUT_LEFT, INPUT_JUMP, INPUT_JUMP | INPUT_RIGHT, INPUT_JUMP | INPUT_LEFT,
+  INPUT_DOWN, INPUT_DOWN | INPUT_RIGHT, INPUT_DOWN | INPUT_LEFT, INPUT_FIRE, INPUT_JETPACK
+};
+
+/* A state stepped with one of the actions */
+struct route_child
+{
+  u64 key;
+  u32 score;
+  u16 cell;       /* Dave's tile, plus 1000 with the trophy */
+  u8 status;
+  u8 ticks;       /* Fewer than ROUTE_HOLD if the level ended early */
+};
+
+/* Where a state of a layer came from */
+struct route_step
+{
+  u16 parent;
+  u8 action;
+};
+
+struct route_search;
+
+struct route_worker
+{
+  int id;
+  struct route_search *search;
+  u64 simulated;
+  struct game_state game;   /* Scratch for stepping children */
+};
+
+struct route_search
+{
+  u8 level;
+  u32 width;
+  int threads;
+  u16 distance[2][1000];          /* To the trophy, then to the door */
+  u32 visits[ROUTE_CELLS];        /* States picked in each tile so far */
+
+  struct game_state *states[2];   /* width each, layers alternate */
+  struct route_step *steps;       /* width per layer */
+  struct route_child *children;   /* ROUTE_ACTIONS per state */
+  u64 *order;
+  u32 layer;
+  u32 count;                      /* States in the layer */
+
+  u64 *table;                     /* Keys seen, 0 is empty */
+  u32 table_size;                 /* A power of two */
+  u32 table_used;
+
+  struct workpool work;           /* States of the layer left to expand */
+  struct route_worker *worker;
+};
+
+/* Tile steps from every tile to the nearest one with flag, through
+   tiles Dave can be in */
+static void fill_distance(u16 *distance, u8 level, u8 flag)
+{
+  u16 queue[1000];
+  u32 head = 0, tail = 0;
+  u16 i, next;
+  u8 flags;
+  int d;
+  const int step[4] = {1, -1, 100, -100};
+
+  for (i = 0; i < 1000; i++)
+  {
+    distance[i] = ROUTE_FAR;
+    if (tile_props[levels[level].tiles[i]].flags & flag)
+    {
+      distance[i] = 0;
+      queue[tail++] = i;
+    }
+  }
+
+  while (head < tail)
+  {
+    i = queue[head++];
+    for (d = 0; d < 4; d++)
+    {
+      /* No wrapping from one row's end to the next */
+      if ((d == 0 && i % 100 == 99) || (d == 1 && i % 100 == 0) || (int)i + step[d] < 0 || (int)i + step[d] >= 1000)
+        continue;
+
+      next = (u16)(i + step[d]);
+      flags = tile_props[levels[level].tiles[next]].flags;
+      if (distance[next] != ROUTE_FAR || (flags & (TILE_SOLID | TILE_HAZARD)))
+        continue;
+
+      distance[next] = distance[i] + 1;
+      queue[tail++] = next;
+    }
+  }
+}
+
+/* Dave's tile, 2000 when he is off the level */
+static u16 cell(const struct game_state *game)
+{
+  int x = (game->dave_px + TILE_SIZE / 2) / TILE_SIZE;
+  int y = (game->dave_py + TILE_SIZE / 2) / TILE_SIZE;
+
+  if (x < 0 || x >= 100 || y < 0 || y >= 10)
+    return ROUTE_CELLS - 1;
+
+  return (u16)((game->trophy ? 1000 : 0) + y * 100 + x);
+}
+
+/* Lower is closer. Every state without the trophy ranks behind every
+   state with it */
+static u32 score(const struct route_search *s, u16 cell)
+{
+  if (cell == ROUTE_CELLS - 1)
+    return 0x10000 + ROUTE_FAR;
+
+  return (cell < 1000 ? 0x10000 : 0) + s->distance[cell / 1000][cell % 1000];
+}
+
+/* State hash without the animation counters, so reaching the same
+   place again later counts as the same state */
+static u64 route_key(struct game_state *game)
+{
+  u8 tick = game->tick;
+  u8 dave_tick = game->dave_tick;
+  u64 key;
+
+  game->tick = 0;
+  game->dave_tick = 0;
+  key = state_hash(game);
+  game->tick = tick;
+  game->dave_tick = dave_tick;
+
+  return key ? key : 1;
+}
+
+/* Step state i of the layer from its parent, then try every action */
+static void expand(struct route_worker *worker, u32 i)
+{
+  struct route_search *s = worker->search;
+  struct game_state *node = &s->states[s->layer & 1][i];
+  struct game_state *game = &worker->game;
+  const struct route_step *step;
+  struct route_child *child;
+  u32 a, t;
+
+  if (s->layer)
+  {
+    step = &s->steps[s->layer * s->width + i];
+    memcpy(node, &s->states[(s->layer - 1) & 1][step->parent], sizeof(struct game_state));
+    for (t = 0; t < ROUTE_HOLD; t++)
+      step_game(node, actions[step->action]);
+    worker->simulated += ROUTE_HOLD;
+  }
+
+  for (a = 0; a < ROUTE_ACTIONS; a++)
+  {
+    child = &s->children[i * ROUTE_ACTIONS + a];
+    child->status = ROUTE_OPEN;
+    memcpy(game, node, sizeof(struct game_state));
+
+    for (t = 0; t < ROUTE_HOLD && child->status == ROUTE_OPEN; t++)
+    {
+      step_game(game, actions[a]);
+
+      /* Dying always costs a life, never worth it */
+      if (game->dave_dead_timer)
+        child->status = ROUTE_DEAD;
+      else if (game->current_level != s->level || game->quit)
+        child->status = ROUTE_DONE;
+    }
+    child->ticks = (u8)t;
+    worker->simulated += t;
+
+    if (child->status == ROUTE_OPEN)
+    {
+      child->cell = cell(game);
+      child->score = score(s, child->cell);
+      child->key = route_key(game);
+    }
+  }
+}
+
+static int run_worker(void *data)
+{
+  struct route_worker *worker = (struct route_worker *)data;
+  u32 i;
+
+  while (workpool_take(&worker->search->work, worker->id, &i))
+    expand(worker, i);
+
+  return 0;
+}
+
+/* Expand every state of the layer across the workers */
+static void expand_layer(struct route_search *s)
+{
+  workpool_init(&s->work, s->count, s->threads);
+  workpool_run(&s->work, run_worker, s->worker, sizeof(struct route_worker), "route");
+}
+
+/* Add a key. Returns 0 if it was already there */
+static int table_insert(struct route_search *s, u64 key)
+{
+  u64 *old;
+  u32 size, i, j;
+
+  /* Keep it at most half full */
+  if ((s->table_used + 1) * 2 > s->table_size)
+  {
+    old = s->table;
+    size = s->table_size;
+    s->table_size *= 2;
+    s->table = (u64 *)calloc(s->table_size, sizeof(u64));
+    for (i = 0; i < size; i++)
+    {
+      if (!old[i])
+        continue;
+      j = (u32)old[i] & (s->table_size - 1);
+      while (s->table[j])
+        j = (j + 1) & (s->table_size - 1);
+      s->table[j] = old[i];
+    }
+    free(old);
+  }
+
+  for (i = (u32)key & (s->table_size - 1); s->table[i]; i = (i + 1) & (s->table_size - 1))
+  {
+    if (s->table[i] == key)
+      return 0;
+  }
+
+  s->table[i] = key;
+  s->table_used++;
+  return 1;
+}
+
+static int compare_order(const void *a, const void *b)
+{
+  u64 x = *(const u64 *)a;
+  u64 y = *(const u64 *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Pick the next layer, the closest children not seen before. Ties go
+   to the lower child index. Returns the number picked */
+static u32 select_layer(struct route_search *s, struct route_result *result)
+{
+  struct route_step *next = &s->steps[(s->layer + 1) * s->width];
+  const struct route_child *child;
+  u16 per_cell[ROUTE_CELLS];
+  u32 count = 0, picked = 0;
+  u32 c;
+
+  memset(per_cell, 0, sizeof(per_cell));
+
+  for (c = 0; c < s->count * ROUTE_ACTIONS; c++)
+  {
+    if (s->children[c].status == ROUTE_OPEN)
+      s->order[count++] = (u64)(s->children[c].score + s->visits[s->children[c].cell] / ROUTE_PATIENCE) << 32 | c;
+  }
+  qsort(s->order, count, sizeof(u64), compare_order);
+
+  for (c = 0; c < count && picked < s->width; c++)
+  {
+    child = &s->children[(u32)s->order[c]];
+    if (per_cell[child->cell] >= ROUTE_CELL_MAX)
+      continue;
+    if (!table_insert(s, child->key))
+    {
+      result->duplicates++;
+      continue;
+    }
+
+    next[picked].parent = (u16)((u32)s->order[c] / ROUTE_ACTIONS);
+    next[picked].action = (u8)((u32)s->order[c] % ROUTE_ACTIONS);
+    per_cell[child->cell]++;
+    s->visits[child->cell]++;
+    picked++;
+  }
+
+  return picked;
+}
+
+/* Inputs from the start to child c of the layer */
+static void build_route(struct route_search *s, u32 c, struct route_result *result)
+{
+  const struct route_step *step;
+  u32 i = c / ROUTE_ACTIONS;
+  u32 layer, t;
+
+  result->ticks = s->layer * ROUTE_HOLD + s->children[c].ticks;
+  result->inputs = (u8 *)malloc(result->ticks);
+
+  for (t = 0; t < s->children[c].ticks; t++)
+    result->inputs[s->layer * ROUTE_HOLD + t] = actions[c % ROUTE_ACTIONS];
+
+  for (layer = s->layer; layer > 0; layer--)
+  {
+    step = &s->steps[layer * s->width + i];
+    for (t = 0; t < ROUTE_HOLD; t++)
+      result->inputs[(layer - 1) * ROUTE_HOLD + t] = actions[step->action];
+    i = step->parent;
+  }
+}
+
+/* Search for a way through the level start is at, width states per
+   layer, up to max_ticks. Returns 0 if a route was found */
+int route_search(const struct game_state *start, u32 width, u32 max_ticks, int threads, struct route_result *result)
+{
+  struct route_search s;
+  u32 layers = max_ticks / ROUTE_HOLD + 1;
+  u64 timer_begin = SDL_GetPerformanceCounter();
+  u32 done, c;
+  int k;
+
+  memset(result, 0, sizeof(struct route_result));
+
+  if (width < 1)
+    width = 1;
+  if (width > 0xFFFF)
+    width = 0xFFFF;
+  if (threads < 1)
+    threads = 1;
+  if (threads > WORKPOOL_MAX_THREADS)
+    threads = WORKPOOL_MAX_THREADS;
+
+  s.level = start->current_level;
+  s.width = width;
+  s.threads = threads;
+  fill_distance(s.distance[0], s.level, TILE_TROPHY);
+  fill_distance(s.distance[1], s.level, TILE_DOOR);
+  memset(s.visits, 0, sizeof(s.visits));
+
+  s.states[0] = (struct game_state *)malloc(width * sizeof(struct game_state));
+  s.states[1] = (struct game_state *)malloc(width * sizeof(struct game_state));
+  s.steps = (struct route_step *)malloc((layers + 1) * width * sizeof(struct route_step));
+  s.children = (struct route_child *)malloc(width * ROUTE_ACTIONS * sizeof(struct route_child));
+  s.order = (u64 *)malloc(width * ROUTE_ACTIONS * sizeof(u64));
+  s.table_size = 1024;
+  s.table_used = 0;
+  s.table = (u64 *)calloc(s.table_size, sizeof(u64));
+  s.worker = (struct route_worker *)calloc(threads, sizeof(struct route_worker));
+  for (k = 0; k < threads; k++)
+  {
+    s.worker[k].id = k;
+    s.worker[k].search = &s;
+  }
+
+  /* Layer 0 is the start on its own */
+  memcpy(&s.states[0][0], start, sizeof(struct game_state));
+  memcpy(&s.worker[0].game, start, sizeof(struct game_state));
+  table_insert(&s, route_key(&s.worker[0].game));
+  s.count = 1;
+
+  for (s.layer = 0; s.layer < layers && s.count; s.layer++)
+  {
+    expand_layer(&s);
+    result->nodes += s.count;
+
+    /* Fewest ticks wins, then the lowest index */
+    done = s.count * ROUTE_ACTIONS;
+    for (c = 0; c < s.count * ROUTE_ACTIONS; c++)
+    {
+      if (s.children[c].status == ROUTE_DONE && (done == s.count * ROUTE_ACTIONS || s.children[c].ticks < s.children[done].ticks))
+        done = c;
+    }
+
+    if (done < s.count * ROUTE_ACTIONS && s.layer * ROUTE_HOLD + s.children[done].ticks <= max_ticks)
+    {
+      build_route(&s, done, result);
+      result->found = 1;
+      break;
+    }
+
+    s.count = select_layer(&s, result);
+  }
+  result->layers = s.layer;
+
+  for (k = 0; k < threads; k++)
+    result->simulated += s.worker[k].simulated;
+  result->seconds = (double)(SDL_GetPerformanceCounter() - timer_begin) / (double)SDL_GetPerformanceFrequency();
+
+  free(s.states[0]);
+  free(s.states[1]);
+  free(s.steps);
+  free(s.children);
+  free(s.order);
+  free(s.table);
+  free(s.worker);
+
+  return !result->found;
+}
+
+void route_free(struct route_result *result)
+{
+  free(result->inputs);
+  result->inputs = NULL;
+}
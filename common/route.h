@@ -0,0 +1,44 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include "game.h"
+
+#define ROUTE_HOLD 4              /* Ticks each input is held for */
+#define ROUTE_ACTIONS 11          /* Inputs tried from every state */
+#ifndef ROUTE_CELL_MAX
+#define ROUTE_CELL_MAX 8          /* States per tile in a layer */
+#endif
+
+/* Route found through one level, or how far the search got */
+struct route_result
+{
+  u8 found;
+  u32 ticks;          /* Ticks to finish the level */
+  u8 *inputs;         /* Input of every tick, ticks long */
+
+  u32 layers;         /* Search depth reached */
+  u64 nodes;          /* States expanded */
+  u64 simulated;      /* Ticks stepped, re-simulation included */
+  u64 duplicates;     /* States the transposition table dropped */
+  double seconds;
+};
+
+/* Beam search for the trophy, then the door
+ * -every layer holds up to width states, each one a route so far;
+ *  a layer is expanded by stepping each state ROUTE_HOLD ticks with
+ *  each of the ROUTE_ACTIONS inputs
+ * -children that kill Dave are dropped, the rest rank by tile
+ *  distance to the trophy or, once Dave has it, to the door, over
+ *  the tiles he can pass
+ * -a transposition table of state hashes, animation counters left
+ *  out, keeps states already in the beam from coming back
+ * -workers expand states in parallel and steal from each other;
+ *  ranking is on this thread, so routes are the same for any
+ *  number of threads
+ * Only a layer's states are kept, the next layer re-steps its parents'
+ * chosen inputs. The route is rebuilt from the per-layer choices.
+ */
+int route_search(const struct game_state *, u32, u32, int, struct route_result *);
+void route_free(struct route_result *);
+
+#endif // ROUTE_H
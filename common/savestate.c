@@ -0,0 +1,366 @@
+#include <string.h>
+#include <stddef.h>
+#include "savestate.h"
+#include "replay.h"
+#include "entity.h"
+#include "statehash.h"
+
+/* Runtime fields in save order, each written little-endian */
+struct state_field
+{
+  u32 offset;
+  u8 size;
+};
+
+#define STATE_FIELD(f) { offsetof(struct game_state, f), sizeof(((struct game_state *)0)->f) }
+#define ENTITY_FIELD(f) { offsetof(struct entity_pool, f), sizeof(((struct entity_pool *)0)->f[0]) }
+
+static const struct state_field state_fields[] =
+{
+  STATE_FIELD(tick), STATE_FIELD(dave_tick), STATE_FIELD(current_level), STATE_FIELD(quit),
+  STATE_FIELD(dave_px), STATE_FIELD(dave_py), STATE_FIELD(dave_x), STATE_FIELD(dave_y),
+  STATE_FIELD(view_x), STATE_FIELD(view_y), STATE_FIELD(scroll_x), STATE_FIELD(last_dir),
+  STATE_FIELD(on_ground), STATE_FIELD(can_climb), STATE_FIELD(try_input), STATE_FIELD(dave_action),
+  STATE_FIELD(jump_timer), STATE_FIELD(dave_dead_timer), STATE_FIELD(jetpack_delay), STATE_FIELD(jetpack),
+  STATE_FIELD(check_pickup_x), STATE_FIELD(check_pickup_y), STATE_FIELD(check_door),
+  STATE_FIELD(collision_point), STATE_FIELD(score),
+  STATE_FIELD(lives), STATE_FIELD(trophy), STATE_FIELD(gun)
+};
+
+/* One entity's entries in the dense arrays, kind first */
+static const struct state_field entity_fields[] =
+{
+  ENTITY_FIELD(kind), ENTITY_FIELD(type), ENTITY_FIELD(dead_timer), ENTITY_FIELD(dir),
+  ENTITY_FIELD(x), ENTITY_FIELD(y), ENTITY_FIELD(px), ENTITY_FIELD(py),
+  ENTITY_FIELD(path_step)
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static void put_u32(u8 *p, u32 value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static u32 get_u32(const u8 *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (u32)p[3] << 24;
+}
+
+static u16 get_u16(const u8 *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+/* Copy fields out of a struct, 16 and 32-bit ones little-endian.
+   Anything else is a byte array. Array fields (entities) take
+   element index, plain ones index 0 */
+static u8 *put_fields(u8 *p, const void *data, const struct state_field *fields, u32 count, u32 index)
+{
+  const u8 *base = (const u8 *)data;
+  const u8 *field;
+  u16 value16;
+  u32 value32;
+  u32 i;
+
+  for (i = 0; i < count; i++)
+  {
+    field = base + fields[i].offset + index * fields[i].size;
+    if (fields[i].size == 2)
+    {
+      memcpy(&value16, field, 2);
+      p[0] = value16 & 0xFF;
+      p[1] = value16 >> 8;
+    }
+    else if (fields[i].size == 4)
+    {
+      memcpy(&value32, field, 4);
+      put_u32(p, value32);
+    }
+    else
+      memcpy(p, field, fields[i].size);
+    p += fields[i].size;
+  }
+
+  return p;
+}
+
+static const u8 *get_fields(const u8 *p, void *data, const struct state_field *fields, u32 count, u32 index)
+{
+  u8 *base = (u8 *)data;
+  u8 *field;
+  u16 value16;
+  u32 value32;
+  u32 i;
+
+  for (i = 0; i < count; i++)
+  {
+    field = base + fields[i].offset + index * fields[i].size;
+    if (fields[i].size == 2)
+    {
+      value16 = get_u16(p);
+      memcpy(field, &value16, 2);
+    }
+    else if (fields[i].size == 4)
+    {
+      value32 = get_u32(p);
+      memcpy(field, &value32, 4);
+    }
+    else
+      memcpy(field, p, fields[i].size);
+    p += fields[i].size;
+  }
+
+  return p;
+}
+
+static u32 fields_size(const struct state_field *fields, u32 count)
+{
+  u32 size = 0;
+  u32 i;
+
+  for (i = 0; i < count; i++)
+    size += fields[i].size;
+
+  return size;
+}
+
+/* Where a field, going by its offset in the struct, starts in a saved
+   record */
+static u32 field_at(const struct state_field *fields, u32 offset)
+{
+  u32 at = 0;
+  u32 i;
+
+  for (i = 0; fields[i].offset != offset; i++)
+    at += fields[i].size;
+
+  return at;
+}
+
+/* Serialize a game into buf (at least SAVESTATE_MAX bytes). Returns
+   the size */
+u32 savestate_write(const struct game_state *game, u8 *buf)
+{
+  const struct entity_pool *e = &game->entities;
+  u8 *p = buf + SAVESTATE_HEADER;
+  u8 *pickup_count;
+  u32 live = e->live[ENTITY_MONSTER] + e->live[ENTITY_DBULLET] + e->live[ENTITY_EBULLET];
+  u32 count = 0;
+  u32 payload;
+  u16 j;
+
+  p = put_fields(p, game, state_fields, COUNT(state_fields), 0);
+
+  /* Live entities in spawn order. Handles are not kept, nothing in
+     the game state refers to one */
+  p[0] = live & 0xFF;
+  p[1] = live >> 8;
+  p += 2;
+  for (j = 0; j < e->count; j++)
+  {
+    if (e->kind[j] != ENTITY_FREE)
+      p = put_fields(p, e, entity_fields, COUNT(entity_fields), j);
+  }
+
+  /* A handful of items per level, list them instead of the bitset */
+  pickup_count = p;
+  p += 2;
+  for (j = 0; j < 1000; j++)
+  {
+    if (!(game->pickups[j / 8] & (1 << j % 8)))
+      continue;
+    p[0] = j & 0xFF;
+    p[1] = j >> 8;
+    p += 2;
+    count++;
+  }
+  pickup_count[0] = count & 0xFF;
+  pickup_count[1] = count >> 8;
+
+  payload = (u32)(p - buf) - SAVESTATE_HEADER;
+  put_u32(&buf[0], SAVESTATE_MAGIC);
+  put_u32(&buf[4], SAVESTATE_VERSION);
+  put_u32(&buf[8], level_hash());
+  put_u32(&buf[12], payload);
+  put_u32(&buf[16], fnv1a(FNV_BASIS, buf + SAVESTATE_HEADER, payload));
+
+  return SAVESTATE_HEADER + payload;
+}
+
+/* Restore a game from a save state. The game is left untouched unless
+   the whole state checks out. Returns 0 on success */
+int savestate_read(struct game_state *game, const u8 *buf, u32 size)
+{
+  const u8 *p = buf + SAVESTATE_HEADER;
+  u32 fixed = fields_size(state_fields, COUNT(state_fields));
+  u32 record = fields_size(entity_fields, COUNT(entity_fields));
+  u32 path_step = field_at(entity_fields, offsetof(struct entity_pool, path_step));
+  const struct monster_track *track;
+  const u8 *entity;
+  u32 payload;
+  u32 entities;
+  u32 pickups;
+  u32 count;
+  u32 index;
+  u32 level;
+  u32 view_x;
+  i8 dave_x;
+  u32 i;
+  int j;
+
+  if (size < SAVESTATE_HEADER || get_u32(&buf[0]) != SAVESTATE_MAGIC || get_u32(&buf[4]) != SAVESTATE_VERSION)
+  {
+    fprintf(stderr, "Not a save state\n");
+    return 1;
+  }
+
+  payload = get_u32(&buf[12]);
+  if (payload > size - SAVESTATE_HEADER || payload < fixed + 2 || fnv1a(FNV_BASIS, p, payload) != get_u32(&buf[16]))
+  {
+    fprintf(stderr, "Save state is corrupt\n");
+    return 1;
+  }
+
+  if (get_u32(&buf[8]) != level_hash())
+  {
+    fprintf(stderr, "Save state was made with different level data\n");
+    return 1;
+  }
+
+  /* Anything that indexes the level must stay inside it: 10 levels, 100
+     columns each, a 20 column view */
+  level = p[field_at(state_fields, offsetof(struct game_state, current_level))];
+  view_x = p[field_at(state_fields, offsetof(struct game_state, view_x))];
+  dave_x = (i8)p[field_at(state_fields, offsetof(struct game_state, dave_x))];
+  if (level >= 10 || view_x > 80 || dave_x < 0 || dave_x >= 100)
+  {
+    fprintf(stderr, "Save state is corrupt\n");
+    return 1;
+  }
+  track = &tracks[level];
+
+  entities = get_u16(p + fixed);
+  pickups = fixed + 2 + entities * record;
+  if (entities > ENTITY_MAX || payload < pickups + 2)
+  {
+    fprintf(stderr, "Save state is corrupt\n");
+    return 1;
+  }
+
+  count = get_u16(p + pickups);
+  if (payload != pickups + 2 + count * 2)
+  {
+    fprintf(stderr, "Save state is corrupt\n");
+    return 1;
+  }
+
+  /* Monsters step along their level's track, up to its loop end */
+  for (i = 0; i < entities; i++)
+  {
+    entity = p + fixed + 2 + i * record;
+    index = entity[0];
+    if (index == ENTITY_FREE || index >= ENTITY_KINDS ||
+        (index == ENTITY_MONSTER && get_u16(entity + path_step) >= track->loop_end))
+    {
+      fprintf(stderr, "Save state is corrupt\n");
+      return 1;
+    }
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    index = get_u16(p + pickups + 2 + i * 2);
+    if (index >= 1000)
+    {
+      fprintf(stderr, "Save state is corrupt\n");
+      return 1;
+    }
+  }
+
+  p = get_fields(p, game, state_fields, COUNT(state_fields), 0);
+
+  entity_clear(&game->entities);
+  for (p += 2, i = 0; i < entities; i++)
+  {
+    j = entity_spawn(&game->entities, p[0]);
+    p = get_fields(p, &game->entities, entity_fields, COUNT(entity_fields), j);
+  }
+
+  memset(game->pickups, 0, sizeof(game->pickups));
+  for (p += 2, i = 0; i < count; i++, p += 2)
+  {
+    index = p[0] | p[1] << 8;
+    game->pickups[index / 8] |= 1 << index % 8;
+  }
+  game->pickup_hash = pickups_hash(game->pickups);
+
+  return 0;
+}
+
+/* Write a save state to disk in a single write. Returns 0 on success */
+int savestate_save(const struct game_state *game, const char *fname)
+{
+  FILE *fout;
+  u8 buf[SAVESTATE_MAX];
+  u32 size;
+  int failed;
+
+  size = savestate_write(game, buf);
+
+  fout = fopen(fname, "wb");
+  if (!fout)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  /* Unbuffered, so the whole state goes out in one write */
+  setvbuf(fout, NULL, _IONBF, 0);
+  failed = fwrite(buf, size, 1, fout) != 1;
+  fclose(fout);
+
+  if (failed)
+    fprintf(stderr, "Failed to write %s\n", fname);
+
+  return failed;
+}
+
+/* Returns 0 on success */
+int savestate_load(struct game_state *game, const char *fname)
+{
+  FILE *fin;
+  u8 buf[SAVESTATE_MAX];
+  u32 size;
+
+  fin = fopen(fname, "rb");
+  if (!fin)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  size = (u32)fread(buf, 1, SAVESTATE_MAX, fin);
+  fclose(fin);
+
+  return savestate_read(game, buf, size);
+}
+
+void autosave_init(struct autosave *autosave, const struct game_state *game, const char *fname)
+{
+  autosave->fname = fname;
+  autosave->level = game->current_level;
+}
+
+/* Call after every tick, saves on the tick a new level starts */
+void autosave_step(struct autosave *autosave, const struct game_state *game)
+{
+  if (game->current_level == autosave->level || game->quit)
+    return;
+
+  autosave->level = game->current_level;
+  savestate_save(game, autosave->fname);
+}
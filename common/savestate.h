@@ -0,0 +1,37 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include "game.h"
+
+#define SAVESTATE_MAGIC 0x56534444 /* "DDSV" little-endian */
+#define SAVESTATE_VERSION 5
+#define SAVESTATE_HEADER 20
+
+/* Largest possible save state, a full entity pool and every tile
+   picked up */
+#define SAVESTATE_MAX (SAVESTATE_HEADER + 128 + 2 + 16 * ENTITY_MAX + 2 + 2 * 1000)
+
+/* Save state contents
+ * -header: magic, version, level hash, payload size, payload checksum
+ * -payload: runtime fields one by one, live entities as a count
+ *  and their fields each, then the current level's pickups as a
+ *  count and a tile index each
+ * All values little-endian, a session is usually a few hundred bytes
+ */
+
+/* Writes a save state whenever the game moves to another level */
+struct autosave
+{
+  const char *fname;
+  u8 level;
+};
+
+u32 savestate_write(const struct game_state *, u8 *);
+int savestate_read(struct game_state *, const u8 *, u32);
+int savestate_save(const struct game_state *, const char *);
+int savestate_load(struct game_state *, const char *);
+
+void autosave_init(struct autosave *, const struct game_state *, const char *);
+void autosave_step(struct autosave *, const struct game_state *);
+
+#endif // SAVESTATE_H
@@ -0,0 +1,83 @@
+#include <string.h>
+#include "snapshot.h"
+
+/* Slot 0 starts as the reader's, slot 1 as the writer's, slot 2 in the middle */
+void snapshot_init(struct triple_buffer *buffer)
+{
+  memset(buffer->slot, 0, sizeof(buffer->slot));
+  buffer->front = 0;
+  buffer->back = 1;
+  SDL_AtomicSet(&buffer->middle, 2);
+}
+
+/* Copy everything the draw functions need out of the simulation state */
+void snapshot_capture(struct game_state *game, struct render_state *state)
+{
+  int i, j;
+
+  state->quit = game->quit;
+  state->tick = game->tick;
+  state->dave_tick = game->dave_tick;
+  state->current_level = game->current_level;
+  state->score = game->score;
+  state->lives = game->lives;
+  state->view_x = game->view_x;
+  state->dave_px = game->dave_px;
+  state->dave_py = game->dave_py;
+  state->on_ground = game->on_ground;
+  state->last_dir = game->last_dir;
+  state->dave_jump = (game->dave_action & DAVE_JUMP) != 0;
+  state->dave_jetpack = (game->dave_action & DAVE_JETPACK) != 0;
+  state->dave_climb = (game->dave_action & DAVE_CLIMB) != 0;
+  state->dave_dead_timer = game->dave_dead_timer;
+  state->trophy = game->trophy;
+  state->gun = game->gun;
+  state->jetpack = game->jetpack;
+
+  memcpy(&state->entities, &game->entities, sizeof(state->entities));
+  memcpy(state->tiles, levels[game->current_level].tiles, sizeof(state->tiles));
+
+  /* Blank out what has been picked up */
+  for (i = 0; i < 125; i++)
+  {
+    if (!game->pickups[i])
+      continue;
+    for (j = 0; j < 8; j++)
+    {
+      if (game->pickups[i] & (1 << j))
+        state->tiles[i * 8 + j] = 0;
+    }
+  }
+}
+
+/* Slot the writer may fill. Never visible to the reader until published */
+struct render_state *snapshot_back(struct triple_buffer *buffer)
+{
+  return &buffer->slot[buffer->back];
+}
+
+/* Hand the back slot to the reader and take the middle one in exchange */
+void snapshot_publish(struct triple_buffer *buffer)
+{
+  int old;
+
+  /* Slot contents must be visible before the index is */
+  SDL_MemoryBarrierRelease();
+  old = SDL_AtomicSet(&buffer->middle, buffer->back | SNAPSHOT_FRESH);
+  buffer->back = old & ~SNAPSHOT_FRESH;
+}
+
+/* Newest published state, or NULL if nothing new since the last call */
+struct render_state *snapshot_acquire(struct triple_buffer *buffer)
+{
+  int old;
+
+  if (!(SDL_AtomicGet(&buffer->middle) & SNAPSHOT_FRESH))
+    return NULL;
+
+  old = SDL_AtomicSet(&buffer->middle, buffer->front);
+  SDL_MemoryBarrierAcquire();
+  buffer->front = old & ~SNAPSHOT_FRESH;
+
+  return &buffer->slot[buffer->front];
+}
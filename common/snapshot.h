@@ -0,0 +1,15 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "game.h"
+
+/* Set in triple_buffer::middle when the shared slot holds an unread state */
+#define SNAPSHOT_FRESH 0x4
+
+void snapshot_init(struct triple_buffer *);
+void snapshot_capture(struct game_state *, struct render_state *);
+struct render_state *snapshot_back(struct triple_buffer *);
+void snapshot_publish(struct triple_buffer *);
+struct render_state *snapshot_acquire(struct triple_buffer *);
+
+#endif // SNAPSHOT_H
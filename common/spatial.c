@@ -0,0 +1,87 @@
+#include <string.h>
+#include "spatial.h"
+
+/* Bucket a pool's entities of one kind by tile */
+void spatial_build(struct spatial_grid *grid, const struct entity_pool *pool, u8 kind)
+{
+  u16 cell;
+  u16 i;
+
+  grid->pool = pool;
+  grid->kind = kind;
+  grid->bucketed = pool->live[kind] >= SPATIAL_MIN;
+
+  if (!grid->bucketed)
+    return;
+
+  memset(grid->head, 0xFF, sizeof(grid->head));
+  grid->outside = SPATIAL_NONE;
+
+  /* Back to front, so each list comes out in spawn order */
+  for (i = pool->count; i-- > 0;)
+  {
+    if (pool->kind[i] != kind)
+      continue;
+
+    if (pool->x[i] < SPATIAL_COLS && pool->y[i] < SPATIAL_ROWS)
+    {
+      cell = pool->y[i] * SPATIAL_COLS + pool->x[i];
+      grid->next[i] = grid->head[cell];
+      grid->head[cell] = i;
+    }
+    else
+    {
+      grid->next[i] = grid->outside;
+      grid->outside = i;
+    }
+  }
+}
+
+static u8 in_area(const struct entity_pool *pool, u16 i, int x0, int y0, int x1, int y1)
+{
+  return pool->x[i] >= x0 && pool->x[i] <= x1 && pool->y[i] >= y0 && pool->y[i] <= y1;
+}
+
+/* Dense indices of the entities with a tile in x0..x1, y0..y1 (bounds
+   included, any of them may be off the level) into out, which needs
+   room for ENTITY_MAX. Returns how many */
+u32 spatial_query(const struct spatial_grid *grid, int x0, int y0, int x1, int y1, u16 *out)
+{
+  const struct entity_pool *pool = grid->pool;
+  u32 count = 0;
+  int x, y;
+  u16 i;
+
+  if (!grid->bucketed)
+  {
+    for (i = 0; i < pool->count; i++)
+    {
+      if (pool->kind[i] == grid->kind && in_area(pool, i, x0, y0, x1, y1))
+        out[count++] = i;
+    }
+    return count;
+  }
+
+  for (y = y0 < 0 ? 0 : y0; y <= y1 && y < SPATIAL_ROWS; y++)
+  {
+    for (x = x0 < 0 ? 0 : x0; x <= x1 && x < SPATIAL_COLS; x++)
+    {
+      for (i = grid->head[y * SPATIAL_COLS + x]; i != SPATIAL_NONE; i = grid->next[i])
+      {
+        if (pool->kind[i] == grid->kind)
+          out[count++] = i;
+      }
+    }
+  }
+
+  if (x1 >= SPATIAL_COLS || y1 >= SPATIAL_ROWS)
+  {
+    for (i = grid->outside; i != SPATIAL_NONE; i = grid->next[i])
+    {
+      if (pool->kind[i] == grid->kind && in_area(pool, i, x0, y0, x1, y1))
+        out[count++] = i;
+    }
+  }
+
+  return count;
+}
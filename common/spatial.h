@@ -0,0 +1,37 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include "game.h"
+
+#define SPATIAL_COLS 100            /* A level is 100x10 tiles */
+#define SPATIAL_ROWS 10
+#define SPATIAL_NONE 0xFFFF
+
+#ifndef SPATIAL_MIN
+#define SPATIAL_MIN 32              /* Fewer entities than this are just scanned */
+#endif
+
+/* Entities of one kind bucketed by their tile (x, y), rebuilt every
+   time a stage needs it since entities move and compact each tick
+ * -head[y * SPATIAL_COLS + x] is the first dense index in that tile,
+ *  next[i] the one after i, SPATIAL_NONE ends a list
+ * -positions off the level grid share the outside list
+ * -lists hold dense indices in ascending order; an entity destroyed
+ *  after the build is skipped by queries
+ * With few entities nothing is bucketed and queries scan the pool,
+ * so a level's handful of monsters costs what it did before.
+ */
+struct spatial_grid
+{
+  const struct entity_pool *pool;
+  u8 kind;
+  u8 bucketed;
+  u16 outside;
+  u16 head[SPATIAL_COLS * SPATIAL_ROWS];
+  u16 next[ENTITY_MAX];
+};
+
+void spatial_build(struct spatial_grid *, const struct entity_pool *, u8);
+u32 spatial_query(const struct spatial_grid *, int, int, int, int, u16 *);
+
+#endif // SPATIAL_H
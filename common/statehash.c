@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include "statehash.h"
+
+#define PICKUP_SEED 0x5049434B55505321ull   /* "!SPUKCIP" */
+#define ENTITY_SEED 0x454E544954594B45ull
+
+/* splitmix64 finalizer, every input bit reaches every output bit */
+u64 hash_mix(u64 x)
+{
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBull;
+  x ^= x >> 31;
+  return x;
+}
+
+/* Zobrist key of the pickup at tile index */
+u64 pickup_key(u16 index)
+{
+  return hash_mix(PICKUP_SEED + index);
+}
+
+/* pickup_hash from scratch */
+u64 pickups_hash(const u8 *pickups)
+{
+  u64 hash = 0;
+  u16 i;
+
+  for (i = 0; i < 1000; i++)
+  {
+    if (pickups[i / 8] & (1 << i % 8))
+      hash ^= pickup_key(i);
+  }
+
+  return hash;
+}
+
+/* One live entity, every field but its dense place */
+static u64 entity_term(const struct entity_pool *e, u16 i)
+{
+  u64 a = e->kind[i] | e->type[i] << 8 | e->dead_timer[i] << 16 | (u64)(u8)e->dir[i] << 24 |
+          (u64)e->x[i] << 32 | (u64)e->y[i] << 40 | (u64)e->slot[i] << 48;
+  u64 b = e->px[i] | (u64)e->py[i] << 16 | (u64)e->path_step[i] << 32;
+
+  return hash_mix(a ^ hash_mix(b ^ ENTITY_SEED));
+}
+
+u64 state_hash(const struct game_state *game)
+{
+  const struct entity_pool *e = &game->entities;
+  const u8 *p = (const u8 *)game;
+  const u32 size = offsetof(struct game_state, pickups);
+  u64 hash = game->pickup_hash;
+  u64 word;
+  u32 n;
+  u16 i;
+
+#ifdef STATE_HASH_CHECK
+  if (game->pickup_hash != pickups_hash(game->pickups))
+  {
+    fprintf(stderr, "State hash drifted on level %u at tick %u\n", game->current_level + 1, game->tick);
+    abort();
+  }
+#endif
+
+  /* Fields before pickups, a word at a time */
+  for (n = 0; n < size; n += sizeof(word))
+  {
+    word = 0;
+    memcpy(&word, p + n, size - n < sizeof(word) ? size - n : sizeof(word));
+    hash = hash_mix(hash ^ word);
+  }
+
+  for (i = 0; i < e->count; i++)
+  {
+    if (e->kind[i] != ENTITY_FREE)
+      hash ^= entity_term(e, i);
+  }
+
+  return hash;
+}
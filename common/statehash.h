@@ -0,0 +1,25 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include "game.h"
+
+/* 64-bit hash of a game_state, for telling runs apart without
+   comparing or hashing the whole state
+ * -pickups are Zobrist keyed, a key per tile XORed in by pickup_item
+ *  as it happens, kept in game_state.pickup_hash
+ * -every live entity adds a term keyed by its slot, so spawn order
+ *  and compaction make no difference. Only live entities are hashed,
+ *  not the unused rest of the pool
+ * -the fields before pickups, one cache line that most ticks rewrite
+ *  anyway, are mixed in whole. game_state has no padding there, so
+ *  every byte is a field
+ * Build with -DSTATE_HASH_CHECK to recompute pickup_hash on every call
+ * and report when it has drifted.
+ */
+
+u64 hash_mix(u64);
+u64 pickup_key(u16);
+u64 pickups_hash(const u8 *);
+u64 state_hash(const struct game_state *);
+
+#endif // STATEHASH_H
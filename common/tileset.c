@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+#include "tileset.h"
+#include "assets.h"
+
+struct tile_property tile_props[256];
+
+/* A run of tiles sharing the same properties */
+struct tile_range
+{
+  u8 first;
+  u8 last;
+  u8 flags;
+  u16 score;
+  u8 frames;
+};
+
+/* Original Dangerous Dave tileset
+   https://moddingwiki.shikadi.net/wiki/Dangerous_Dave_Tileset_Format */
+static const struct tile_range dave_tiles[] = {
+    /* Walls, pipes and platforms */
+    {1, 1, TILE_SOLID, 0, 1},
+    {3, 3, TILE_SOLID, 0, 1},
+    {5, 5, TILE_SOLID, 0, 1},
+    {15, 19, TILE_SOLID, 0, 1},
+    {21, 24, TILE_SOLID, 0, 1},
+    {29, 30, TILE_SOLID, 0, 1},
+    /* Exit door */
+    {2, 2, TILE_DOOR, 0, 1},
+    /* Jetpack, trophy, gun */
+    {4, 4, TILE_PICKUP | TILE_JETPACK, 0, 1},
+    {10, 10, TILE_PICKUP | TILE_TROPHY, 1000, 5},
+    {20, 20, TILE_PICKUP | TILE_GUN, 0, 1},
+    /* Collectibles */
+    {47, 47, TILE_PICKUP, 100, 1},
+    {48, 48, TILE_PICKUP, 50, 1},
+    {49, 49, TILE_PICKUP, 150, 1},
+    {50, 50, TILE_PICKUP, 300, 1},
+    {51, 51, TILE_PICKUP, 200, 1},
+    {52, 52, TILE_PICKUP, 500, 1},
+    /* Fire, water, weeds */
+    {6, 6, TILE_HAZARD, 0, 4},
+    {25, 25, TILE_HAZARD, 0, 4},
+    {36, 36, TILE_HAZARD, 0, 5},
+    /* Trees and stars */
+    {33, 35, TILE_CLIMB, 0, 1},
+    {41, 41, TILE_CLIMB, 0, 1},
+    /* Explosion */
+    {129, 129, 0, 0, 4}};
+
+static void apply_range(const struct tile_range *range)
+{
+  int i;
+
+  for (i = range->first; i <= range->last; i++)
+  {
+    tile_props[i].flags = range->flags;
+    tile_props[i].score = range->score;
+    tile_props[i].frames = range->frames ? range->frames : 1;
+  }
+}
+
+/* Expand the tile ranges into the lookup table. Everything else is empty space */
+void init_tile_props(void)
+{
+  u32 i;
+
+  memset(tile_props, 0, sizeof(tile_props));
+  for (i = 0; i < 256; i++)
+    tile_props[i].frames = 1;
+
+  for (i = 0; i < sizeof(dave_tiles) / sizeof(dave_tiles[0]); i++)
+    apply_range(&dave_tiles[i]);
+}
+
+/* Override tile properties for a custom tileset. One range per line:
+     first last flags score frames
+   Lines starting with # are ignored, and so are ranges animating past
+   the last tile. Returns 0 on success */
+int load_tile_props(const char *fname)
+{
+  FILE *fin;
+  char line[128];
+  unsigned int first, last, score, frames;
+  int flags;
+  struct tile_range range;
+
+  fin = fopen(fname, "r");
+  if (!fin)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), fin))
+  {
+    if (line[0] == '#')
+      continue;
+
+    if (sscanf(line, "%u %u %i %u %u", &first, &last, &flags, &score, &frames) != 5 || first > last || last > 255)
+      continue;
+
+    /* Every frame of the last tile's animation has to be a tile */
+    if (last + (frames ? frames : 1) > ASSET_TILES)
+      continue;
+
+    range.first = (u8)first;
+    range.last = (u8)last;
+    range.flags = (u8)flags;
+    range.score = (u16)score;
+    range.frames = (u8)frames;
+    apply_range(&range);
+  }
+
+  fclose(fin);
+  return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef TILESET_H
+#define TILESET_H
+
+#include <SDL.h>
+#include "variables.h"
+
+/* Tile property flags */
+#define TILE_SOLID 0x01
+#define TILE_DOOR 0x02
+#define TILE_PICKUP 0x04
+#define TILE_HAZARD 0x08
+#define TILE_CLIMB 0x10
+#define TILE_JETPACK 0x20
+#define TILE_TROPHY 0x40
+#define TILE_GUN 0x80
+
+/* Tiles that do something when Dave touches them */
+#define TILE_TOUCH (TILE_DOOR | TILE_PICKUP | TILE_HAZARD)
+
+/* Behaviour of one tileset index
+ * -flags is a set of TILE_* bits
+ * -score is added when the tile is picked up
+ * -frames is the animation length, starting at this index
+ */
+struct tile_property
+{
+  u8 flags;
+  u8 frames;
+  u16 score;
+};
+
+/* Indexed by tile type. Built once by init_tile_props, read-only after */
+extern struct tile_property tile_props[256];
+
+void init_tile_props(void);
+int load_tile_props(const char *);
+
+#endif // TILESET_H
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+#include "profiler.h"
+
+static struct trace_buffer *buffers[TRACE_THREADS];
+static SDL_atomic_t buffer_count;
+static SDL_atomic_t flushing;
+static SDL_TLSID buffer_key;
+static SDL_Thread *flush_thread;
+static FILE *fout;
+static u64 trace_origin;
+static double us_per_count;
+static u8 first_event;
+
+/* Append everything the owning thread has produced since the last drain */
+static void drain(struct trace_buffer *buffer)
+{
+  struct trace_event *e;
+  int tail = SDL_AtomicGet(&buffer->tail);
+  int head = SDL_AtomicGet(&buffer->head);
+
+  SDL_MemoryBarrierAcquire();
+  for (; tail != head; tail++)
+  {
+    e = &buffer->event[tail & (TRACE_EVENTS - 1)];
+    fprintf(fout, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            first_event ? "" : ",",
+            e->name,
+            buffer->tid,
+            (double)(e->begin - trace_origin) * us_per_count,
+            (double)(e->end - e->begin) * us_per_count);
+    first_event = 0;
+  }
+
+  /* Hand the slots back to the producer */
+  SDL_AtomicSet(&buffer->tail, tail);
+}
+
+/* Flush thread. Keeps file I/O off the game loop */
+static int run_flush(void *data)
+{
+  int i, count;
+
+  while (SDL_AtomicGet(&flushing))
+  {
+    /* Threads past TRACE_THREADS still count, but get no buffer */
+    count = SDL_AtomicGet(&buffer_count);
+    count = count > TRACE_THREADS ? TRACE_THREADS : count;
+    for (i = 0; i < count; i++)
+      if (SDL_AtomicGetPtr((void **)&buffers[i]))
+        drain(buffers[i]);
+    SDL_Delay(50);
+  }
+
+  return 0;
+}
+
+/* Open the trace file and start recording on this thread. Returns 0 on success */
+int trace_start(const char *fname)
+{
+  fout = fopen(fname, "w");
+  if (!fout)
+  {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return 1;
+  }
+
+  fprintf(fout, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  first_event = 1;
+  trace_origin = SDL_GetPerformanceCounter();
+  us_per_count = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+  buffer_key = SDL_TLSCreate();
+  SDL_AtomicSet(&buffer_count, 0);
+
+  profiler_enabled |= PROFILE_TRACE;
+  trace_thread_begin("main");
+
+  SDL_AtomicSet(&flushing, 1);
+  flush_thread = SDL_CreateThread(run_flush, "trace", NULL);
+  return 0;
+}
+
+/* Give the calling thread its own ring buffer, taking over one an
+   ended thread of the same name left. No-op unless tracing */
+void trace_thread_begin(const char *name)
+{
+  struct trace_buffer *buffer;
+  int i, count, tid;
+
+  if (!(profiler_enabled & PROFILE_TRACE))
+    return;
+
+  count = SDL_AtomicGet(&buffer_count);
+  count = count > TRACE_THREADS ? TRACE_THREADS : count;
+  for (i = 0; i < count; i++)
+  {
+    buffer = (struct trace_buffer *)SDL_AtomicGetPtr((void **)&buffers[i]);
+    if (buffer && !strcmp(buffer->thread_name, name) && SDL_AtomicCAS(&buffer->idle, 1, 0))
+    {
+      SDL_TLSSet(buffer_key, buffer, NULL);
+      return;
+    }
+  }
+
+  tid = SDL_AtomicAdd(&buffer_count, 1);
+  if (tid >= TRACE_THREADS)
+    return;
+
+  buffer = (struct trace_buffer *)calloc(1, sizeof(struct trace_buffer));
+  buffer->thread_name = name;
+  buffer->tid = tid;
+  SDL_TLSSet(buffer_key, buffer, NULL);
+  SDL_AtomicSetPtr((void **)&buffers[tid], buffer);
+}
+
+/* Hand the calling thread's buffer on, for short-lived threads that
+   would otherwise each take a new one */
+void trace_thread_end(void)
+{
+  struct trace_buffer *buffer;
+
+  if (!(profiler_enabled & PROFILE_TRACE))
+    return;
+
+  buffer = (struct trace_buffer *)SDL_TLSGet(buffer_key);
+  if (!buffer)
+    return;
+
+  SDL_TLSSet(buffer_key, NULL, NULL);
+
+  /* Its last events must be in before the next owner appends */
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&buffer->idle, 1);
+}
+
+/* Queue one event on the calling thread's buffer. Drops it when full */
+void trace_record(const char *name, u64 begin, u64 end)
+{
+  struct trace_buffer *buffer = (struct trace_buffer *)SDL_TLSGet(buffer_key);
+  struct trace_event *e;
+  int head;
+
+  if (!buffer)
+    return;
+
+  head = SDL_AtomicGet(&buffer->head);
+  if (head - SDL_AtomicGet(&buffer->tail) >= TRACE_EVENTS)
+  {
+    SDL_AtomicAdd(&buffer->dropped, 1);
+    return;
+  }
+
+  e = &buffer->event[head & (TRACE_EVENTS - 1)];
+  e->name = name;
+  e->begin = begin;
+  e->end = end;
+
+  /* Event must be complete before the flush thread can see it */
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&buffer->head, head + 1);
+}
+
+/* Stop the flush thread, write what is left plus thread names and close */
+void trace_stop(void)
+{
+  int i, count;
+
+  if (!fout)
+    return;
+
+  profiler_enabled &= ~PROFILE_TRACE;
+  SDL_AtomicSet(&flushing, 0);
+  SDL_WaitThread(flush_thread, NULL);
+
+  count = SDL_AtomicGet(&buffer_count);
+  count = count > TRACE_THREADS ? TRACE_THREADS : count;
+  for (i = 0; i < count; i++)
+  {
+    if (!buffers[i])
+      continue;
+
+    drain(buffers[i]);
+    fprintf(fout, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first_event ? "" : ",", buffers[i]->tid, buffers[i]->thread_name);
+    first_event = 0;
+    if (SDL_AtomicGet(&buffers[i]->dropped))
+      fprintf(stderr, "trace: %s dropped %d events\n", buffers[i]->thread_name, SDL_AtomicGet(&buffers[i]->dropped));
+    free(buffers[i]);
+    buffers[i] = NULL;
+  }
+
+  fprintf(fout, "\n]}\n");
+  fclose(fout);
+  fout = NULL;
+}
@@ -0,0 +1,38 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <SDL.h>
+#include "variables.h"
+
+/* Per-thread ring buffer size. Must be a power of two */
+#define TRACE_EVENTS 16384
+#define TRACE_THREADS 16
+
+/* One complete ("X") event in the Chrome trace-event format */
+struct trace_event
+{
+  const char *name;
+  u64 begin;
+  u64 end;
+};
+
+/* Single-producer single-consumer ring. The owning thread appends,
+   the flush thread drains */
+struct trace_buffer
+{
+  struct trace_event event[TRACE_EVENTS];
+  SDL_atomic_t head;
+  SDL_atomic_t tail;
+  SDL_atomic_t dropped;
+  SDL_atomic_t idle;    /* Its thread has ended, another can take it over */
+  const char *thread_name;
+  int tid;
+};
+
+int trace_start(const char *);
+void trace_thread_begin(const char *);
+void trace_thread_end(void);
+void trace_record(const char *, u64, u64);
+void trace_stop(void);
+
+#endif // TRACE_H
@@ -1,34 +1,19 @@
 #ifndef LMDAVE_H
 #define LMDAVE_H
 
+#include <stddef.h>
+
 typedef uint8_t u8;
 typedef int8_t i8;
 typedef uint16_t u16;
 typedef int16_t i16;
 typedef uint32_t u32;
 typedef int32_t i32;
+typedef uint64_t u64;
 
 #define TILE_SIZE 16
 #define DISPLAY_SCALE 3
 
-/* Format of the level information
- * -path is used for monster movement
- * -tiles contain tileset indices
- * -padding unused but included for capatibility
- */
-struct monster_state
-{
-	u8 type;
-	u8 path_index;
-  u8 dead_timer;
-	u8 monster_x;
-	u8 monster_y;
-	u16 monster_px;
-	u16 monster_py;
-	i8 next_px;
-	i8 next_py;
-};
-
 /* Format of the level information
  * -path is used for monster movement
  * -tiles contain tileset indices
@@ -41,73 +26,195 @@ struct dave_level
   u8 padding[24];
 };
 
-/* Game state information in kitchen-sink format
- *    (Refactor me please!!!)
+#define TRACK_MAX 8192
+
+/* A level's monster path compiled to a position per step
+ * -x and y are pixel offsets from the monster's starting point
+ * -after loop_end the path carries on from loop_start, so
+ *  x[loop_end] - x[loop_start] is how far one loop moves it
+ */
+struct monster_track
+{
+  u16 loop_start;
+  u16 loop_end;
+  i16 x[TRACK_MAX + 1];
+  i16 y[TRACK_MAX + 1];
+};
+
+#ifndef ENTITY_MAX
+#define ENTITY_MAX 32 /* A level has at most 5 monsters and 2 bullets.
+                          Benchmark builds may raise it, up to 0xFFFE */
+#endif
+#define ENTITY_NONE 0  /* Never a valid handle */
+
+/* Entity kinds. Destroyed entities are ENTITY_FREE until compacted */
+#define ENTITY_FREE 0
+#define ENTITY_MONSTER 1
+#define ENTITY_DBULLET 2  /* Dave's bullet */
+#define ENTITY_EBULLET 3  /* Monster bullet */
+#define ENTITY_KINDS 4
+
+/* Pool of monsters and bullets in structure-of-arrays layout
+ * -kind through slot are dense: live entities in spawn order,
+ *  indices 0 to count - 1
+ * -x and y are the grid position, px and py the pixel position,
+ *  type the monster tile, dir a bullet's direction, path_step
+ *  a monster's place on its level's monster_track
+ * -a handle is generation << 16 | slot and stays valid while its
+ *  entity lives, index maps a slot to its dense index
+ * -free slots are chained through index as next slot + 1, slots
+ *  from used on have never been handed out. All zero is empty
+ */
+struct entity_pool
+{
+  u16 count;
+  u16 used;
+  u16 free_slot;            /* First free slot + 1, 0 if none */
+  u16 live[ENTITY_KINDS];   /* Entities of each kind */
+
+  u8 kind[ENTITY_MAX];
+  u8 type[ENTITY_MAX];
+  u8 dead_timer[ENTITY_MAX];
+  i8 dir[ENTITY_MAX];
+  u8 x[ENTITY_MAX];
+  u8 y[ENTITY_MAX];
+  u16 px[ENTITY_MAX];
+  u16 py[ENTITY_MAX];
+  u16 path_step[ENTITY_MAX];
+  u16 slot[ENTITY_MAX];
+
+  u16 index[ENTITY_MAX];
+  u16 generation[ENTITY_MAX];
+};
+
+#define CACHE_LINE 64
+
+/* Fails to compile when cond is false */
+#define STATIC_ASSERT(cond, name) typedef char static_assert_##name[(cond) ? 1 : -1]
+
+/* Game state information, only what changes during play
+ * -hot: fields every tick reads or writes, packed into the first
+ *  cache line, held keys and accepted moves as INPUT_* / DAVE_* bits
+ * -cold: score, lives, items and pickups change on events only
+ * -entities: monsters and bullets last, most of the pool is unused
  */
 struct game_state
 {
-  u8 quit;
   u8 tick;
   u8 dave_tick;
   u8 current_level;
-  u32 score;
-	u8 lives;
+  u8 quit;
+  i16 dave_px;
+  i16 dave_py;
+  i8 dave_x;
+  i8 dave_y;
   u8 view_x;
   u8 view_y;
   i8 scroll_x;
-  i8 dave_x;
-	i8 dave_y;
-	i16 dave_px;
-	i16 dave_py;
-  u8 on_ground;
   i8 last_dir;
-
-  u8 try_right;
-  u8 try_left;
-  u8 try_jump;
-  u8 try_fire;
-	u8 try_jetpack;
-	u8 try_down;
-	u8 try_up;
-  u8 dave_right;
-  u8 dave_left;
-  u8 dave_jump;
-  u8 dave_fire;
-	u8 dave_jetpack;
-  u8 dave_climb;
-	u8 dave_down;
-	u8 dave_up;
+  u8 on_ground;
+  u8 can_climb;
+  u8 try_input;   /* INPUT_* keys held since the last tick */
+  u8 dave_action; /* DAVE_* moves verify_input accepted */
   u8 jump_timer;
   u8 dave_dead_timer;
   u8 jetpack_delay;
+  u8 jetpack;
   u8 check_pickup_x;
-	u8 check_pickup_y;
+  u8 check_pickup_y;
   u8 check_door;
-  u8 can_climb;
-	u8 trophy;
-	u8 gun;
-	u8 jetpack;
+  u8 collision_point[9];
+  u8 pad[2];          /* Always zero, state_hash reads it */
+  u32 score;
 
-  u16 dbullet_px;
-	u16 dbullet_py;
-	i8 dbullet_dir;
-	u16 ebullet_px;
-	u16 ebullet_py;
-	i8 ebullet_dir;
+  u8 lives;
+  u8 trophy;
+  u8 gun;
 
-  u8 collision_point[9];
+  /* Bit per tile of the current level, set once it has been picked up.
+     The level data itself is shared, see levels in game.h */
+  u8 pickups[125];
+  u64 pickup_hash;    /* Zobrist hash of pickups, see statehash.h */
+
+  struct entity_pool entities;
+};
+
+STATIC_ASSERT(offsetof(struct game_state, score) + sizeof(u32) <= CACHE_LINE, game_state_hot_fields_fit_a_cache_line);
+STATIC_ASSERT(ENTITY_MAX < 0xFFFF, entity_slots_fit_u16);
+
+/* state_hash reads the bytes before pickups whole, so they must all be
+   fields: no padding before the multi-byte ones */
+STATIC_ASSERT(offsetof(struct game_state, dave_px) == offsetof(struct game_state, quit) + 1, game_state_no_padding_before_dave_px);
+STATIC_ASSERT(offsetof(struct game_state, score) == offsetof(struct game_state, pad) + sizeof(((struct game_state *)0)->pad), game_state_no_padding_before_score);
+
+/* Render-relevant subset of game_state
+ * -published by the simulation thread once per tick
+ * -only ever read by the render thread
+ * -tiles is a copy of the current level (pickups removed)
+ */
+struct render_state
+{
+  u8 quit;
+  u8 tick;
+  u8 dave_tick;
+  u8 current_level;
+  u32 score;
+  u8 lives;
+  u8 view_x;
+  i16 dave_px;
+  i16 dave_py;
+  u8 on_ground;
+  i8 last_dir;
+  u8 dave_jump;
+  u8 dave_jetpack;
+  u8 dave_climb;
+  u8 dave_dead_timer;
+  u8 trophy;
+  u8 gun;
+  u8 jetpack;
+
+  /* Latency tags. The first input edge of the newest tick that had one,
+     carried into every state until another comes along */
+  u64 input_time;     /* When the edge was drained from SDL */
+  u64 sim_time;       /* When the tick that took it finished */
+  u8 input_press;     /* The tick had a press, not just releases */
+  u8 flash;           /* Set by the render thread, draw the marker */
+
+  struct entity_pool entities;
+  u8 tiles[1000];
+};
 
-  struct monster_state monster[5];
-  struct dave_level level[10];
+/* Lock-free triple buffer of render states
+ * -back is owned by the writer, front by the reader
+ * -middle holds the shared slot index plus SNAPSHOT_FRESH
+ *  when it has not been picked up by the reader yet
+ */
+struct triple_buffer
+{
+  struct render_state slot[3];
+  SDL_atomic_t middle;
+  int back;
+  int front;
 };
 
 /* Game asset structure
  * Only tileset data for now
  * Could include music/sounds, etc
+ * -loader is the background decode, NULL once every tile is a texture
+ *  (see assets.h)
+ * -startup is when init_assets began, for time to first frame
+ * -watch reloads edited files during play, NULL unless asked for
+ *  (see watch.h)
  */
+struct asset_loader;
+struct asset_watch;
+
 struct game_assets
 {
   SDL_Texture *graphics_tiles[158];
+  struct asset_loader *loader;
+  u64 startup;
+  struct asset_watch *watch;
 };
 
 #endif
\ No newline at end of file
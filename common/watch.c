@@ -0,0 +1,170 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <string.h>
+#include <sys/stat.h>
+#include "watch.h"
+#include "levelcache.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/* Watched file n, levels first */
+static void file_name(char *fname, size_t size, int n)
+{
+  if (n < 10)
+    snprintf(fname, size, "level%d.dat", n);
+  else
+    snprintf(fname, size, "tile%d.bmp", n - 10);
+}
+
+/* Watched file number of a file name, or -1 */
+static int file_number(const char *name)
+{
+  char fname[16];
+  int n;
+
+  for (n = 0; n < WATCH_FILES; n++)
+  {
+    file_name(fname, sizeof(fname), n);
+    if (!strcmp(name, fname))
+      return n;
+  }
+
+  return -1;
+}
+
+/* Modified time of watched file n, 0 if it is missing */
+static long modified(int n)
+{
+  char fname[16];
+  struct stat st;
+
+  file_name(fname, sizeof(fname), n);
+  return stat(fname, &st) ? 0 : (long)st.st_mtime;
+}
+
+void watch_open(struct asset_watch *watch)
+{
+  int n;
+
+  SDL_AtomicSet(&watch->levels, 0);
+  watch->polled = SDL_GetTicks();
+  watch->fd = -1;
+
+#ifdef __linux__
+  /* Editors that save to a temporary file rename it over the old one */
+  watch->fd = inotify_init1(IN_NONBLOCK);
+  if (watch->fd >= 0 && inotify_add_watch(watch->fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+  {
+    close(watch->fd);
+    watch->fd = -1;
+  }
+#endif
+
+  for (n = 0; n < WATCH_FILES; n++)
+    watch->mtime[n] = modified(n);
+}
+
+/* A watched file was written */
+static void changed(struct asset_watch *watch, struct game_assets *assets, SDL_Renderer *renderer, int n)
+{
+  int old;
+
+  if (n < 10)
+  {
+    do
+      old = SDL_AtomicGet(&watch->levels);
+    while (!SDL_AtomicCAS(&watch->levels, old, old | 1 << n));
+  }
+  else if (!reload_tile(assets, renderer, n - 10))
+    printf("Reloaded tile%d.bmp\n", n - 10);
+}
+
+/* Pick up changed files. Render thread, once a frame */
+void watch_poll(struct asset_watch *watch, struct game_assets *assets, SDL_Renderer *renderer)
+{
+  long mtime;
+  int n;
+
+  /* Textures are still being made from the first decode */
+  if (assets->loader)
+    return;
+
+#ifdef __linux__
+  if (watch->fd >= 0)
+  {
+    union
+    {
+      struct inotify_event event;
+      char bytes[4096];
+    } buf;
+    const struct inotify_event *event;
+    ssize_t size;
+    ssize_t at;
+
+    while ((size = read(watch->fd, buf.bytes, sizeof(buf))) > 0)
+    {
+      for (at = 0; at < size; at += sizeof(struct inotify_event) + event->len)
+      {
+        event = (const struct inotify_event *)&buf.bytes[at];
+        if (event->len && (n = file_number(event->name)) >= 0)
+          changed(watch, assets, renderer, n);
+      }
+    }
+    return;
+  }
+#endif
+
+  if (SDL_GetTicks() - watch->polled < WATCH_POLL_MS)
+    return;
+  watch->polled = SDL_GetTicks();
+
+  for (n = 0; n < WATCH_FILES; n++)
+  {
+    mtime = modified(n);
+    if (mtime == watch->mtime[n])
+      continue;
+    watch->mtime[n] = mtime;
+    if (mtime)
+      changed(watch, assets, renderer, n);
+  }
+}
+
+/* Reload the levels watch_poll saw change. Simulation thread, between
+   ticks */
+void watch_levels(struct asset_watch *watch, struct game_state *game)
+{
+  const struct monster_track *track = &tracks[game->current_level];
+  struct entity_pool *e = &game->entities;
+  int bits = SDL_AtomicSet(&watch->levels, 0);
+  int j;
+  u16 i;
+
+  for (j = 0; j < 10; j++)
+  {
+    if (!(bits & 1 << j) || level_reload(j))
+      continue;
+    printf("Reloaded level%d.dat\n", j);
+
+    if (j != game->current_level)
+      continue;
+    for (i = 0; i < e->count; i++)
+    {
+      if (e->kind[i] == ENTITY_MONSTER && e->path_step[i] >= track->loop_end)
+        e->path_step[i] = track->loop_start;
+    }
+  }
+}
+
+void watch_close(struct asset_watch *watch)
+{
+#ifdef __linux__
+  if (watch->fd >= 0)
+    close(watch->fd);
+#endif
+  watch->fd = -1;
+}
@@ -0,0 +1,35 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "game.h"
+#include "assets.h"
+
+#define WATCH_FILES (10 + ASSET_TILES)  /* level0-9.dat, then tile0-157.bmp */
+#define WATCH_POLL_MS 500               /* Without inotify, how often to stat */
+
+/* Reloads levelN.dat and tileN.bmp as they change on disk, for editing
+   levels and tiles with the game running
+ * -on Linux an inotify watch on the working directory reports files
+ *  written or moved in, elsewhere their modified times are polled
+ * -watch_poll runs on the render thread. A changed tile becomes a new
+ *  texture there and then, a changed level sets its bit in levels
+ * -watch_levels runs on the simulation thread between ticks, the only
+ *  place levels[] can be rewritten while a game is played
+ * Levels nobody has started yet load fresh when they are. A level that
+ * changes under Dave keeps his position and the items he picked up,
+ * monsters past the end of a shorter path go back to where it loops.
+ */
+struct asset_watch
+{
+  int fd;                       /* inotify descriptor, -1 when polling */
+  long mtime[WATCH_FILES];
+  u32 polled;                   /* SDL_GetTicks of the last poll */
+  SDL_atomic_t levels;          /* Bit per level waiting to reload */
+};
+
+void watch_open(struct asset_watch *);
+void watch_poll(struct asset_watch *, struct game_assets *, SDL_Renderer *);
+void watch_levels(struct asset_watch *, struct game_state *);
+void watch_close(struct asset_watch *);
+
+#endif // WATCH_H
@@ -0,0 +1,105 @@
+#include "workpool.h"
+
+/* Deal count items out in equal ranges, to at most threads workers and
+   no more workers than items */
+void workpool_init(struct workpool *pool, u32 count, int threads)
+{
+  int k;
+
+  if (threads < 1)
+    threads = 1;
+  if (threads > WORKPOOL_MAX_THREADS)
+    threads = WORKPOOL_MAX_THREADS;
+  if (count && (u32)threads > count)
+    threads = (int)count;
+
+  pool->threads = threads;
+  for (k = 0; k < threads; k++)
+  {
+    pool->range[k].lock = 0;
+    pool->range[k].next = (u32)((u64)count * k / threads);
+    pool->range[k].end = (u32)((u64)count * (k + 1) / threads);
+  }
+}
+
+/* Take the next item of a worker's own range. Returns 0 when it is
+   empty */
+static int take(struct workpool_range *range, u32 *i)
+{
+  int found = 0;
+
+  SDL_AtomicLock(&range->lock);
+  if (range->next < range->end)
+  {
+    *i = range->next++;
+    found = 1;
+  }
+  SDL_AtomicUnlock(&range->lock);
+
+  return found;
+}
+
+/* Move the back half of another worker's range to this one. Returns 0
+   once every item is taken */
+static int steal(struct workpool *pool, int thief)
+{
+  struct workpool_range *victim;
+  u32 begin = 0;
+  u32 end = 0;
+  u32 half;
+  int k;
+
+  for (k = 1; k < pool->threads && begin == end; k++)
+  {
+    victim = &pool->range[(thief + k) % pool->threads];
+
+    SDL_AtomicLock(&victim->lock);
+    if (victim->next < victim->end)
+    {
+      half = (victim->end - victim->next + 1) / 2;
+      end = victim->end;
+      begin = victim->end = end - half;
+    }
+    SDL_AtomicUnlock(&victim->lock);
+  }
+
+  if (begin == end)
+    return 0;
+
+  SDL_AtomicLock(&pool->range[thief].lock);
+  pool->range[thief].next = begin;
+  pool->range[thief].end = end;
+  SDL_AtomicUnlock(&pool->range[thief].lock);
+
+  return 1;
+}
+
+/* Next item for a worker, its own or stolen. Returns 0 once the pool is
+   drained */
+int workpool_take(struct workpool *pool, int worker, u32 *i)
+{
+  do
+  {
+    if (take(&pool->range[worker], i))
+      return 1;
+  } while (steal(pool, worker));
+
+  return 0;
+}
+
+/* Run fn once per worker, worker k getting the k-th element of an array
+   of size byte elements, and wait for them all */
+void workpool_run(struct workpool *pool, SDL_ThreadFunction fn, void *workers, size_t size, const char *name)
+{
+  SDL_Thread *thread[WORKPOOL_MAX_THREADS];
+  int k;
+
+  for (k = 1; k < pool->threads; k++)
+    thread[k] = SDL_CreateThread(fn, name, (u8 *)workers + k * size);
+
+  fn(workers);
+
+  for (k = 1; k < pool->threads; k++)
+    if (thread[k])
+      SDL_WaitThread(thread[k], NULL);
+}
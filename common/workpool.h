@@ -0,0 +1,37 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include "game.h"
+
+#define WORKPOOL_MAX_THREADS 64
+
+/* Items a worker has yet to run, [next, end). A cache line each, so
+   workers taking from their own ranges do not contend */
+struct workpool_range
+{
+  SDL_SpinLock lock;
+  u32 next;
+  u32 end;
+  u8 padding[64 - sizeof(SDL_SpinLock) - 2 * sizeof(u32)];
+};
+
+/* Work-stealing pool over the items [0, count)
+ * -every worker starts with an equal share; it takes from the front of
+ *  its own range, and once that is empty steals the back half of
+ *  another worker's
+ * -items are never added, so a worker that finds nothing to steal is
+ *  done
+ * -the calling thread is worker 0. A worker whose thread fails to start
+ *  just gets its range stolen
+ */
+struct workpool
+{
+  int threads;
+  struct workpool_range range[WORKPOOL_MAX_THREADS];
+};
+
+void workpool_init(struct workpool *, u32, int);
+int workpool_take(struct workpool *, int, u32 *);
+void workpool_run(struct workpool *, SDL_ThreadFunction, void *, size_t, const char *);
+
+#endif // WORKPOOL_H
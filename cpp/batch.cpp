@@ -0,0 +1,75 @@
+/* Runs many independent games at once across all cores, each with its
+ *  own seeded input script, and writes every game's outcome to a JSON
+ *  file with one array per column (seed, ticks, score, deaths, level).
+ *  --lockstep steps the games in structure-of-arrays lanes instead of
+ *  one at a time, with the same results.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include "../common/game.h"
+#include "../common/batch.h"
+
+int main(int argc, char *argv[])
+{
+    u32 count = 1000;   // Games to run
+    u32 ticks = 100000; // Tick limit per game
+    u32 seed = 1;       // Seed of the first game, then seed + 1, ...
+    int level = 0;      // Starting level (0-9)
+    int threads = SDL_GetCPUCount();
+    const char *results_file = "batch.json";
+    u8 lockstep = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--games") && i + 1 < argc)
+            count = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--ticks") && i + 1 < argc)
+            ticks = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--level") && i + 1 < argc)
+            level = std::strtoul(argv[++i], nullptr, 10) > 9 ? -1 : static_cast<int>(std::strtoul(argv[i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+            results_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--lockstep"))
+            lockstep = 1;
+    }
+
+    if (level < 0)
+    {
+        std::cout << "--level must be 0-9" << std::endl;
+        return 1;
+    }
+
+    /* Every game starts from a copy of this state. Levels after it load
+       when the first game to reach one starts it */
+    game_state *start = new game_state();
+    init_game(start);
+    start->current_level = level;
+    start_level(start);
+
+    batch_results results;
+    batch_results_init(&results, count);
+
+    auto timer_begin = std::chrono::steady_clock::now();
+    run_batch(start, seed, count, ticks, threads, lockstep, &results);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - timer_begin;
+
+    u64 total = 0;
+    for (u32 i = 0; i < count; i++)
+        total += results.ticks[i];
+
+    std::cout << count << " games, " << total << " ticks on " << threads << " threads in " << seconds.count()
+              << " s (" << static_cast<u64>(total / seconds.count()) << " ticks/s)" << std::endl;
+
+    batch_results_save(&results, results_file);
+    batch_results_free(&results);
+    delete start;
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+/* Turns the extracted level and tile files into common/embedded.c, so
+ *  the game can be built with them inside (mingw32-make EMBED=1) and
+ *  read no files at run time. Run in the folder with level0-9.dat and
+ *  tile0-157.bmp. Tiles are stored as 8-bit indices into one palette
+ *  of the colors they use.
+ *  embed [file] writes to file instead of ./common/embedded.c
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include "../common/game.h"
+#include "../common/embedded.h"
+
+// Bytes as part of a C initializer, 16 to a line. Signed bytes are
+// written as numbers, 0xFF would not fit an i8 in C++
+static void write_bytes(std::ofstream &fout, const u8 *data, u32 size, const char *indent, bool is_signed)
+{
+    char hex[8];
+
+    for (u32 i = 0; i < size; i++)
+    {
+        if (i % 16 == 0)
+            fout << indent;
+        if (is_signed)
+            fout << static_cast<int>(static_cast<i8>(data[i])) << ",";
+        else
+        {
+            std::snprintf(hex, sizeof(hex), "0x%02X,", data[i]);
+            fout << hex;
+        }
+        fout << (i % 16 == 15 || i + 1 == size ? "\n" : " ");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string out_file = argc > 1 ? argv[1] : "./common/embedded.c";
+    dave_level level[10];
+    embedded_tile tiles[ASSET_TILES];
+    std::vector<u32> palette;
+    std::vector<u8> pixels;
+
+    // Levels go in as they are
+    for (int i = 0; i < 10; i++)
+    {
+        std::string fname = "level" + std::to_string(i) + ".dat";
+        std::ifstream fin(fname, std::ios::binary);
+        if (!fin.read(reinterpret_cast<char *>(&level[i]), sizeof(dave_level)))
+        {
+            std::cerr << "Failed to read " << fname << std::endl;
+            return 1;
+        }
+    }
+
+    // Tiles become palette indices
+    for (int i = 0; i < ASSET_TILES; i++)
+    {
+        std::string fname = "tile" + std::to_string(i) + ".bmp";
+        SDL_Surface *loaded = SDL_LoadBMP(fname.c_str());
+        SDL_Surface *surface = loaded ? SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0) : nullptr;
+        SDL_FreeSurface(loaded);
+        if (!surface)
+        {
+            std::cerr << "Failed to read " << fname << std::endl;
+            return 1;
+        }
+
+        tiles[i].w = static_cast<u16>(surface->w);
+        tiles[i].h = static_cast<u16>(surface->h);
+        tiles[i].offset = static_cast<u32>(pixels.size());
+
+        for (int y = 0; y < surface->h; y++)
+        {
+            const u32 *row = reinterpret_cast<const u32 *>(static_cast<const u8 *>(surface->pixels) + y * surface->pitch);
+            for (int x = 0; x < surface->w; x++)
+            {
+                u32 color = row[x] & 0xFFFFFF;
+                size_t c = 0;
+                while (c < palette.size() && palette[c] != color)
+                    c++;
+                if (c == palette.size())
+                {
+                    if (palette.size() == 256)
+                    {
+                        std::cerr << "The tiles use more than 256 colors" << std::endl;
+                        return 1;
+                    }
+                    palette.push_back(color);
+                }
+                pixels.push_back(static_cast<u8>(c));
+            }
+        }
+        SDL_FreeSurface(surface);
+    }
+
+    std::ofstream fout(out_file);
+    if (!fout)
+    {
+        std::cerr << "Failed to open " << out_file << std::endl;
+        return 1;
+    }
+
+    fout << "/* Generated by embed from level0-9.dat and tile0-157.bmp. Do not\n   edit, run embed again after changing them */\n\n#include \"embedded.h\"\n\n";
+
+    fout << "const struct dave_level embedded_levels[10] =\n{\n";
+    for (int i = 0; i < 10; i++)
+    {
+        fout << "  {\n    {\n";
+        write_bytes(fout, reinterpret_cast<const u8 *>(level[i].path), sizeof(level[i].path), "      ", true);
+        fout << "    },\n    {\n";
+        write_bytes(fout, level[i].tiles, sizeof(level[i].tiles), "      ", false);
+        fout << "    },\n    {\n";
+        write_bytes(fout, level[i].padding, sizeof(level[i].padding), "      ", false);
+        fout << "    }\n  },\n";
+    }
+    fout << "};\n\n";
+
+    fout << "const u8 embedded_palette[256][3] =\n{\n";
+    for (u32 color : palette)
+    {
+        char rgb[32];
+        std::snprintf(rgb, sizeof(rgb), "  {0x%02X, 0x%02X, 0x%02X},\n", color >> 16 & 0xFF, color >> 8 & 0xFF, color & 0xFF);
+        fout << rgb;
+    }
+    fout << "};\n\n";
+
+    fout << "const struct embedded_tile embedded_tiles[ASSET_TILES] =\n{\n";
+    for (int i = 0; i < ASSET_TILES; i++)
+        fout << "  {" << tiles[i].w << ", " << tiles[i].h << ", " << tiles[i].offset << "},\n";
+    fout << "};\n\n";
+
+    fout << "const u8 embedded_pixels[" << pixels.size() << "] =\n{\n";
+    write_bytes(fout, pixels.data(), static_cast<u32>(pixels.size()), "  ", false);
+    fout << "};\n";
+
+    std::cout << out_file << ": 10 levels, " << ASSET_TILES << " tiles, " << palette.size() << " colors, "
+              << pixels.size() << " bytes of pixels" << std::endl;
+    return 0;
+}
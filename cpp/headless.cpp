@@ -0,0 +1,165 @@
+/* Runs the simulation without a window, as fast as the CPU allows.
+ *  Input comes from a seeded script instead of the keyboard, so the
+ *  same arguments always give the same result.
+ *  --record <file> saves the scripted game as a replay, --replay <file>
+ *  plays one back and checks it stays in sync. --repeat <n> runs the
+ *  scripted game n times and reports the fastest, for benchmarking.
+ *  --crowd <n> adds n monsters to the starting level, to see how the
+ *  entity stages scale (builds with a bigger ENTITY_MAX go past 32),
+ *  and counts the ones left at the end by their handles.
+ *  --loopback <ticks> plays a two-player netplay match over an
+ *  in-process link with that much delay (--loss <percent> drops some
+ *  packets) and checks rollback keeps both peers in sync.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include "../common/game.h"
+#include "../common/headless.h"
+
+// Netplay match over a loopback link. Returns 1 if the peers went out of sync
+static int run_loopback(const game_state *start, u32 delay, u32 loss, u32 seed, u32 ticks)
+{
+    netplay *peers = new netplay[2];
+    net_loopback *link = new net_loopback();
+    net_loopback_init(link, delay, loss, seed);
+
+    u64 worst;
+    u32 wrong = headless_loopback(peers, link, start, seed, ticks, &worst);
+
+    std::cout << ticks << " ticks over loopback, " << delay << " ticks delay, " << loss << "% loss" << std::endl;
+    for (u32 p = 0; p < 2; p++)
+        std::cout << "peer " << p << ": " << peers[p].rollbacks << " rollbacks, " << peers[p].resimulated
+                  << " ticks run again, " << peers[p].stalls << " stalls, " << peers[p].desyncs << " desyncs" << std::endl;
+    std::cout << "slowest tick with rollback: " << worst * 1000.0 / SDL_GetPerformanceFrequency() << " ms" << std::endl;
+    wrong += peers[0].desyncs + peers[1].desyncs;
+    std::cout << "netplay: " << (wrong ? "out of sync" : "in sync") << std::endl;
+
+    delete[] peers;
+    delete link;
+    return wrong != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    u32 ticks = 10000000; // Ticks to simulate
+    u32 seed = 1;         // Input script seed
+    int level = 0;        // Starting level (0-9)
+    u32 repeat = 1;       // Timed runs, the fastest is reported
+    u32 crowd = 0;        // Extra monsters on the starting level
+    int delay = -1;       // Loopback netplay link delay in ticks
+    u32 loss = 0;         // Loopback packets lost per 100
+    const char *record_file = nullptr;
+    const char *replay_file = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--ticks") && i + 1 < argc)
+            ticks = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--level") && i + 1 < argc)
+            level = std::strtoul(argv[++i], nullptr, 10) > 9 ? -1 : static_cast<int>(std::strtoul(argv[i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--record") && i + 1 < argc)
+            record_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--crowd") && i + 1 < argc)
+            crowd = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--loopback") && i + 1 < argc)
+            delay = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--loss") && i + 1 < argc)
+            loss = std::strtoul(argv[++i], nullptr, 10);
+    }
+
+    if (level < 0)
+    {
+        std::cout << "--level must be 0-9" << std::endl;
+        return 1;
+    }
+
+    /* Every restart copies this state. Levels after it load when the
+       game first reaches them */
+    game_state *game = new game_state();
+    game_state *start = new game_state();
+    init_game(start);
+    start->current_level = level;
+    start_level(start);
+    std::vector<u32> handles;   // The crowd's, to count the ones left
+    if (crowd && !replay_file && !record_file)
+    {
+        handles.resize(crowd);
+        u32 added = headless_crowd(start, crowd, seed, handles.data());
+        if (added < crowd)
+            std::cout << "crowd: pool is full at " << ENTITY_MAX << " entities" << std::endl;
+        handles.resize(added);
+    }
+    u32 monsters = start->entities.live[ENTITY_MONSTER];
+    *game = *start;
+
+    input_script script;
+    input_script_init(&script, seed);
+
+    if (delay >= 0)
+        return run_loopback(start, delay, loss, seed, ticks);
+
+    replay demo;
+    if (replay_file && replay_load(&demo, replay_file))
+        return 1;
+
+    auto timer_begin = std::chrono::steady_clock::now();
+    u32 games = 0;
+    if (replay_file)
+        ticks = play_headless(game, &demo);
+    else if (record_file)
+        ticks = record_headless(game, &script, &demo, ticks);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - timer_begin;
+
+    /* Every run starts over from the same state and seed */
+    for (u32 r = 0; !replay_file && !record_file && r < (repeat ? repeat : 1); r++)
+    {
+        *game = *start;
+        input_script_init(&script, seed);
+
+        timer_begin = std::chrono::steady_clock::now();
+        games = run_headless(game, start, &script, ticks);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - timer_begin;
+        if (!r || elapsed < seconds)
+            seconds = elapsed;
+    }
+
+    std::cout << ticks << " ticks in " << seconds.count() << " s ("
+              << static_cast<u64>(ticks / seconds.count()) << " ticks/s), " << games << " games ended" << std::endl;
+    if (crowd && monsters)
+        std::cout << monsters << " monsters, " << seconds.count() * 1e9 / (static_cast<double>(ticks) * monsters)
+                  << " ns per monster per tick" << std::endl;
+    int left = 0;
+    if (!handles.empty())
+    {
+        left = headless_crowd_left(game, handles.data(), static_cast<u32>(handles.size()));
+        if (left < 0)
+            std::cout << "crowd: a monster's handle leads to another entity" << std::endl;
+        else
+            std::cout << "crowd: " << left << " of " << handles.size() << " added monsters left" << std::endl;
+    }
+    std::cout << "final: level " << game->current_level + 1 << " score " << game->score
+              << " lives " << static_cast<int>(game->lives) << " dave " << game->dave_px << "," << game->dave_py << std::endl;
+
+    bool desync = replay_file && (demo.mismatches || ticks != demo.ticks);
+    if (replay_file)
+        std::cout << "replay: " << (desync ? "out of sync" : "in sync") << std::endl;
+    else if (record_file)
+        replay_save(&demo, record_file);
+
+    delete game;
+    delete start;
+    if (replay_file || record_file)
+        replay_free(&demo);
+
+    return desync || left < 0;
+}
@@ -1,20 +1,177 @@
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
 #include "../common/game.h"
+#include "../common/profiler.h"
+#include "../common/trace.h"
+#include "../common/tileset.h"
+#include "../common/replay.h"
+#include "../common/savestate.h"
+#include "../common/netplay.h"
+#include "../common/assets.h"
+#include "../common/watch.h"
 
 /* Entry point */
 int main(int argc, char *argv[])
 {
     SDL_Window *window;
     SDL_Renderer *renderer;
+    const char *profile_file = nullptr;
+    const char *trace_file = nullptr;
+    const char *props_file = nullptr;
+    const char *record_file = nullptr;
+    const char *play_file = nullptr;
+    const char *save_file = nullptr;
+    const char *load_file = nullptr;
+    const char *join_host = nullptr;
+    int host_port = -1;
+    bool watching = false;
+
+    /* --profile <file> times the game loop and writes a JSON report at exit
+       --trace <file> records a Chrome/Perfetto trace of every frame
+       --tile-props <file> overrides tile behaviour for a custom tileset
+       --record <file> saves every tick's input as a replay
+       --play <file> plays a replay back instead of the keyboard
+       --save <file> saves the session every time a level starts
+       --load <file> resumes a saved session (not with replays)
+       --latency-flash flashes a corner on the first frame showing a key press
+       --host <port> waits on a UDP port for a two-player netplay match
+       --join <host:port> joins one as the second player
+       --frames <n> quits after n frames and prints how long each startup
+                    phase took (see startup.sh)
+       --watch reloads level and tile files as they change (not with
+               replays or netplay)
+       --loose reads level and tile files in a build with them embedded */
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--profile") && i + 1 < argc)
+            profile_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+            trace_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--tile-props") && i + 1 < argc)
+            props_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--record") && i + 1 < argc)
+            record_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--play") && i + 1 < argc)
+            play_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--save") && i + 1 < argc)
+            save_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--load") && i + 1 < argc)
+            load_file = argv[++i];
+        else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+            profiler_frames = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--watch"))
+        {
+            watching = true;
+            assets_loose = 1;
+        }
+        else if (!std::strcmp(argv[i], "--loose"))
+            assets_loose = 1;
+        else if (!std::strcmp(argv[i], "--latency-flash"))
+            profiler_flash = 1;
+        else if (!std::strcmp(argv[i], "--host") && i + 1 < argc)
+            host_port = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--join") && i + 1 < argc)
+        {
+            join_host = argv[++i];
+            char *colon = std::strrchr(argv[i], ':');
+            if (!colon)
+            {
+                std::cout << "--join needs host:port" << std::endl;
+                return 1;
+            }
+            *colon = '\0';
+            host_port = std::atoi(colon + 1);
+        }
+    }
+
+    /* Both peers start from a fresh game, replays and saves stay local */
+    net_transport transport;
+    netplay *net = nullptr;
+    if (host_port >= 0)
+    {
+        if (net_udp_open(&transport, join_host ? 0 : host_port, join_host, host_port))
+            return 1;
+        net = new netplay();
+        play_file = nullptr;
+        record_file = nullptr;
+        save_file = nullptr;
+        load_file = nullptr;
+    }
+
+    replay demo;
+    replay *active = nullptr;
+    if (play_file && replay_load(&demo, play_file))
+        return 1;
+
+    startup_mark(STARTUP_BEGIN);
+    profiler_init();
+    profiler_enabled = profile_file ? PROFILE_TIMERS : 0;
+    if (trace_file)
+        trace_start(trace_file);
 
     /* Allocate and initialize game state and assets */
     game_state *game = new game_state();
     game_assets *assets = new game_assets();
 
-    init_game(game);                       /* Initialize game state */
-    init_sdl(&window, &renderer);          /* Initialize SDL */
-    init_assets(assets, renderer);         /* Initialize assets */
+    PROFILE(PROF_INIT_GAME, init_game(game));                 /* Initialize game state */
+    startup_mark(STARTUP_INIT_GAME);
+    if (props_file)
+        load_tile_props(props_file);
+    PROFILE(PROF_INIT_ASSETS, init_assets(assets, game->current_level)); /* Decode assets in the background */
+    startup_mark(STARTUP_INIT_ASSETS);
+    init_sdl(&window, &renderer);                             /* Initialize SDL */
+    startup_mark(STARTUP_INIT_SDL);
     start_level(game);
-    run_game_loop(game, renderer, assets); /* Game loop with fixed time step at 30 FPS*/
+    startup_mark(STARTUP_START_LEVEL);
+    if (play_file)
+        active = replay_start(&demo, game) ? nullptr : &demo;
+    else if (record_file)
+    {
+        replay_record(&demo, game);
+        active = &demo;
+    }
+    else if (load_file)
+        savestate_load(game, load_file);
+    autosave autosave;
+    if (save_file)
+        autosave_init(&autosave, game, save_file);
+    if (net)
+        netplay_init(net, game, join_host != nullptr, &transport);
+    asset_watch watch;
+    if (watching && !active && !net)
+    {
+        watch_open(&watch);
+        assets->watch = &watch;
+    }
+    run_game_loop(game, renderer, assets, active, save_file ? &autosave : nullptr, net); /* Game loop with fixed time step at 30 FPS*/
+
+    trace_stop();
+    if (assets->watch)
+        watch_close(&watch);
+    if (profiler_frames)
+        startup_print();
+    if (profile_file)
+        profiler_dump(profile_file);
+    if (active && active->mode == REPLAY_RECORD)
+        replay_save(active, record_file);
+    if (active && active->mismatches)
+        std::cout << "Replay went out of sync " << active->mismatches << " times" << std::endl;
+    if (play_file || record_file)
+        replay_free(&demo);
+    if (net)
+    {
+        if (net->ended == NETPLAY_REMOTE_QUIT)
+            std::cout << "Netplay: the other player left" << std::endl;
+        else if (net->ended == NETPLAY_TIMED_OUT)
+            std::cout << "Netplay: lost the other player, nothing heard for " << NETPLAY_TIMEOUT / 30 << " s" << std::endl;
+        else
+            netplay_quit(net);
+        std::cout << "Netplay: " << net->rollbacks << " rollbacks, " << net->resimulated << " ticks run again, "
+                  << net->stalls << " stalls, " << net->desyncs << " desyncs" << std::endl;
+        net_close(&transport);
+        delete net;
+    }
 
     /* Clean up and quit */
     SDL_Quit();
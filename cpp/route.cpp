@@ -0,0 +1,125 @@
+/* Searches for a route through each level, trophy then door, with a
+ *  parallel beam search over the simulation, and saves each one as a
+ *  replay (route1.rep ... route10.rep). Exits with 1 if a level has no
+ *  route within the tick limit, or a route found does not finish its
+ *  level when played back, or its replay cannot be saved. Level 10 is
+ *  the one exception, see ROUTE_UNSOLVED.
+ *  --level <n> searches one level (0-9), --width <n> sets the states
+ *  kept per layer (a level without a route is retried at up to 16
+ *  times that), --ticks <n> the longest route, --threads <n> the
+ *  workers, --out <prefix> the replay file names.
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include "../common/game.h"
+#include "../common/route.h"
+#include "../common/replay.h"
+
+constexpr u32 ROUTE_WIDEN = 16; // Widest retry, times --width
+
+// Level 10 has no route yet: the search finds Dave falling through the
+// floor of the start room and walking along the row above the level, a
+// simulation bug, and never the trophy. Its missing route is reported but
+// does not fail the run
+constexpr int ROUTE_UNSOLVED = 9;
+
+// Play a route back from a fresh game into a replay. Returns true if it
+// does not finish the level
+static bool record_route(const route_result &route, u8 level, const std::string &fname)
+{
+    game_state *game = new game_state();
+    init_game(game);
+    game->current_level = level;
+    start_level(game);
+
+    replay rep;
+    replay_record(&rep, game);
+    for (u32 t = 0; t < route.ticks; t++)
+        replay_step(&rep, game, route.inputs[t]);
+
+    bool failed = game->current_level == level && !game->quit;
+    if (!failed)
+        failed = replay_save(&rep, fname.c_str()) != 0;
+
+    replay_free(&rep);
+    delete game;
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    u32 width = 256;   // States kept per layer
+    u32 ticks = 6000;  // Longest route per level
+    int threads = SDL_GetCPUCount();
+    int first = 0;     // Levels to search (0-9)
+    int last = 9;
+    std::string prefix = "route";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--level") && i + 1 < argc)
+            first = last = std::strtoul(argv[++i], nullptr, 10) > 9 ? -1 : static_cast<int>(std::strtoul(argv[i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--width") && i + 1 < argc)
+            width = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--ticks") && i + 1 < argc)
+            ticks = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+            prefix = argv[++i];
+    }
+
+    if (first < 0)
+    {
+        std::cout << "--level must be 0-9" << std::endl;
+        return 1;
+    }
+
+    game_state *start = new game_state();
+    u64 total = 0;
+    double seconds = 0;
+    bool failed = false;
+
+    for (int level = first; level <= last; level++)
+    {
+        // start_level loads the level, or finds it loaded already
+        init_game(start);
+        start->current_level = level;
+        start_level(start);
+
+        // A level the beam misses gets searched again, twice as wide
+        route_result route;
+        u32 w;
+        for (w = width; ; w *= 2)
+        {
+            route_search(start, w, ticks, threads, &route);
+            total += route.simulated;
+            seconds += route.seconds;
+            if (route.found || w >= width * ROUTE_WIDEN)
+                break;
+            route_free(&route);
+        }
+
+        std::cout << "level " << level + 1 << ": ";
+        if (route.found)
+            std::cout << route.ticks << " ticks (" << route.ticks / 30.0 << " s of play)";
+        else
+            std::cout << "no route within " << ticks << " ticks" << (level == ROUTE_UNSOLVED ? " (known bug)" : "");
+        std::cout << ", width " << w << ", " << route.layers << " layers, " << route.nodes << " states, "
+                  << route.duplicates << " duplicates, " << route.seconds << " s" << std::endl;
+
+        std::string fname = prefix + std::to_string(level + 1) + ".rep";
+        if (route.found ? record_route(route, static_cast<u8>(level), fname) : level != ROUTE_UNSOLVED)
+            failed = true;
+        route_free(&route);
+    }
+
+    std::cout << total << " ticks simulated on " << threads << " threads in " << seconds
+              << " s (" << static_cast<u64>(total / seconds) << " ticks/s)" << std::endl;
+
+    delete start;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+#!/bin/sh
+# Times IMDAVE's startup over many launches and prints min/p50/p90/max
+#  of every phase (see --frames in c/imdave.c).
+#  --runs <n> launches (default 20), --frames <n> frames each run shows
+#  before quitting (default 1), --exe <path> the game to launch,
+#  --cold drops the page cache before every run so level and tile files
+#  come from disk (Linux, needs root). Without it the runs are warm.
+
+runs=20
+frames=1
+exe=./IMDAVE
+cold=0
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --runs) runs=$2; shift ;;
+        --frames) frames=$2; shift ;;
+        --exe) exe=$2; shift ;;
+        --cold) cold=1 ;;
+        *) echo "Unknown option $1"; exit 1 ;;
+    esac
+    shift
+done
+
+if [ $cold -eq 1 ] && [ ! -w /proc/sys/vm/drop_caches ]; then
+    echo "--cold needs root on Linux to write /proc/sys/vm/drop_caches"
+    exit 1
+fi
+
+lines=$(mktemp)
+trap 'rm -f "$lines"' EXIT
+
+i=0
+while [ $i -lt $runs ]; do
+    if [ $cold -eq 1 ]; then
+        sync
+        echo 3 > /proc/sys/vm/drop_caches
+    fi
+    "$exe" --frames "$frames" | grep '^Startup:' >> "$lines"
+    i=$((i + 1))
+done
+
+if [ ! -s "$lines" ]; then
+    echo "$exe printed no startup times"
+    exit 1
+fi
+
+# "Startup: init_game 0.120 ms, ..., total 9.870 ms" -> "init_game 0.120" rows,
+# then the distribution of each phase in the order they ran
+echo "$(wc -l < "$lines") runs, $([ $cold -eq 1 ] && echo cold || echo warm), times in ms"
+printf '%-12s %9s %9s %9s %9s\n' phase min p50 p90 max
+for phase in $(head -n 1 "$lines" | sed 's/^Startup: //; s/ [0-9.]* ms,\{0,1\}//g'); do
+    sed "s/.* $phase \([0-9.]*\) ms.*/\1/" "$lines" | sort -n | awk -v phase="$phase" '
+        { v[NR] = $1 }
+        END {
+            p50 = v[int((NR - 1) * 0.5) + 1]
+            p90 = v[int((NR - 1) * 0.9) + 1]
+            printf "%-12s %9.3f %9.3f %9.3f %9.3f\n", phase, v[1], p50, p90, v[NR]
+        }'
+done